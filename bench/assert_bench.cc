@@ -0,0 +1,156 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+//
+// The cost of MUTILS_ASSERT* in a tight loop
+//
+// The same kernel is built three times:
+// - without assertions
+// - with MUTILS_ASSERT*, which hand failures to an out-of-line cold handler
+// - with the previous macros, which built the failure message inline at every call site
+//
+// Reported are ns/element, instructions/element (when perf counters are
+// available), and the machine code size of each kernel (excluding the cold handlers)
+//
+
+// Assertions are the subject of this benchmark, so they are always enabled
+#undef NDEBUG
+#undef MUTILS_ASSERT_MODE
+
+#include "./bench.h"
+#include "mutils/assert.h"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mutils;
+
+// Place a kernel in a named section, so its code size can be measured
+// through the linker-provided __start_/__stop_ symbols
+#define KERNEL(name) __attribute__((noinline, used, section(name)))
+
+#define SECTION_BOUNDS(name)                                                                                           \
+  extern "C" char __start_##name[];                                                                                   \
+  extern "C" char __stop_##name[];
+
+//
+// The previous definitions, which format the message inline
+//
+#define LEGACY_ASSERTION_ERROR(condition, ASSERTION_REASON, errmsg)                                                    \
+  if (!(condition)) {                                                                                                  \
+    const auto message = std::string("[[Assertion Error @ " __FILE__ ":" COMPTIME_STRINGIFY(__LINE__) " ]] :: ") +     \
+                         std::string(ASSERTION_REASON) + "\n\t" + std::string(errmsg);                                 \
+    mutils::PANIC(message);                                                                                            \
+  }
+
+#define LEGACY_BINARY_ASSERTION_ERROR(a, b, operator_name, operator_symbol, errmsg)                                    \
+  {                                                                                                                    \
+    auto __$a_eval = a;                                                                                                \
+    auto __$b_eval = b;                                                                                                \
+    LEGACY_ASSERTION_ERROR(__$a_eval operator_symbol __$b_eval,                                                        \
+                           "MUTILS_ASSERT." operator_name "( " COMPTIME_STRINGIFY(a) ", " COMPTIME_STRINGIFY(          \
+                               b) " )  -> [" +                                                                         \
+                               mutils::stringify(__$a_eval) + " " #operator_symbol " " +                               \
+                               mutils::stringify(__$b_eval) + "] evaluated to false",                                  \
+                           errmsg);                                                                                    \
+  }
+
+#define LEGACY_ASSERT(expr, error)                                                                                     \
+  LEGACY_ASSERTION_ERROR((bool)(expr), "MUTILS_ASSERT.true " COMPTIME_STRINGIFY(expr), error)
+#define LEGACY_ASSERT_NEQ(a, b, error) LEGACY_BINARY_ASSERTION_ERROR(a, b, "not_equal", !=, error)
+#define LEGACY_ASSERT_LT(a, b, error) LEGACY_BINARY_ASSERTION_ERROR(a, b, "lesser", <, error)
+#define LEGACY_ASSERT_GTE(a, b, error) LEGACY_BINARY_ASSERTION_ERROR(a, b, "greater_eq", >=, error)
+
+#define NO_ASSERT(expr, error)
+#define NO_ASSERT_NEQ(a, b, error)
+#define NO_ASSERT_LT(a, b, error)
+#define NO_ASSERT_GTE(a, b, error)
+
+//
+// A weighted histogram lookup, with a handful of assertions per element
+//
+#define DEFINE_KERNEL(fn, name, ASSERT)                                                                                \
+  KERNEL(name) long fn(int const* samples, std::size_t n, int const* weights, [[maybe_unused]] std::size_t weight_count) { \
+    long sum = 0;                                                                                                      \
+    for (std::size_t i = 0; i < n; i++) {                                                                              \
+      int x = samples[i];                                                                                              \
+      ASSERT##_LT(i, n, "index out of range");                                                                         \
+      ASSERT##_GTE(x, 0, "samples are never negative");                                                                \
+      ASSERT##_LT(std::size_t(x), weight_count, "sample " + std::to_string(i) + " has no weight");                     \
+      ASSERT##_NEQ(weights[x], 0, "weights are never zero");                                                           \
+      ASSERT(sum >= 0, "the sum overflowed");                                                                          \
+      sum += long(weights[x]) * x;                                                                                     \
+    }                                                                                                                  \
+    return sum;                                                                                                        \
+  }
+
+DEFINE_KERNEL(unchecked_kernel, "bench_unchecked", NO_ASSERT)
+DEFINE_KERNEL(cold_kernel, "bench_cold", MUTILS_ASSERT)
+DEFINE_KERNEL(legacy_kernel, "bench_legacy", LEGACY_ASSERT)
+
+SECTION_BOUNDS(bench_unchecked)
+SECTION_BOUNDS(bench_cold)
+SECTION_BOUNDS(bench_legacy)
+
+template <typename Fn> static void report(char const* name, std::size_t elements, Fn&& pass) {
+  static bench::InstructionCounter counter;
+
+  double ns = bench::measure_ns(pass) / double(elements);
+  if (counter.available()) {
+    double instructions = double(counter.count(pass)) / double(elements);
+    std::printf("  %-28s %8.3f ns/element %8.2f instructions/element\n", name, ns, instructions);
+  } else {
+    std::printf("  %-28s %8.3f ns/element\n", name, ns);
+  }
+}
+
+int main() {
+  std::mt19937                    rng(7);
+  std::uniform_int_distribution<> sample(0, 255);
+  std::uniform_int_distribution<> weight(1, 100);
+
+  std::vector<int> samples(1 << 16);
+  std::vector<int> weights(256);
+  for (auto& x : samples) {
+    x = sample(rng);
+  }
+  for (auto& w : weights) {
+    w = weight(rng);
+  }
+
+  auto run = [&](auto kernel) {
+    return [&, kernel] {
+      bench::do_not_optimize(kernel(samples.data(), samples.size(), weights.data(), weights.size()));
+    };
+  };
+
+  std::printf("weighted histogram, 5 assertions per element\n");
+  report("no assertions", samples.size(), run(unchecked_kernel));
+  report("MUTILS_ASSERT (cold handler)", samples.size(), run(cold_kernel));
+  report("inline message formatting", samples.size(), run(legacy_kernel));
+
+  std::printf("\ncode size (machine code of each kernel)\n");
+  std::printf("  %-28s %8zu B\n", "no assertions", std::size_t(__stop_bench_unchecked - __start_bench_unchecked));
+  std::printf("  %-28s %8zu B\n", "MUTILS_ASSERT (cold handler)", std::size_t(__stop_bench_cold - __start_bench_cold));
+  std::printf("  %-28s %8zu B\n", "inline message formatting", std::size_t(__stop_bench_legacy - __start_bench_legacy));
+}
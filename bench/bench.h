@@ -0,0 +1,140 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+//
+// bench.h
+//
+// Minimal timing helpers shared by the mutils benchmarks
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+namespace mutils::bench {
+
+//
+// Prevent the optimizer from discarding the computation of `value`
+//
+template <typename T> inline void do_not_optimize(T const& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+//
+// Run `fn` repeatedly for at least `min_duration`, returning the
+// average number of nanoseconds per call
+//
+template <typename Fn>
+double measure_ns(Fn&& fn, std::chrono::milliseconds min_duration = std::chrono::milliseconds(200)) {
+  using Clock = std::chrono::steady_clock;
+
+  // Warm up caches and branch predictors
+  for (int i = 0; i < 16; i++) {
+    fn();
+  }
+
+  std::size_t iterations = 1;
+  while (true) {
+    auto start = Clock::now();
+    for (std::size_t i = 0; i < iterations; i++) {
+      fn();
+    }
+    auto elapsed = Clock::now() - start;
+
+    if (elapsed >= min_duration) {
+      return std::chrono::duration<double, std::nano>(elapsed).count() / double(iterations);
+    }
+    iterations *= 2;
+  }
+}
+
+//
+// Counts the user-space instructions retired by the calling thread, through perf_event_open
+//
+// Counters are often unavailable (non-Linux systems, containers, or a restrictive
+// perf_event_paranoid), in which case `available()` is false and nothing is counted
+//
+class InstructionCounter {
+  int m_fd = -1;
+
+public:
+  InstructionCounter() {
+#if defined(__linux__)
+    perf_event_attr attr{};
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof(attr);
+    attr.config         = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    m_fd                = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+
+  ~InstructionCounter() {
+#if defined(__linux__)
+    if (m_fd >= 0) {
+      close(m_fd);
+    }
+#endif
+  }
+
+  InstructionCounter(InstructionCounter const&)            = delete;
+  InstructionCounter& operator=(InstructionCounter const&) = delete;
+
+  bool available() const {
+    return m_fd >= 0;
+  }
+
+  /**
+   * Count the instructions retired while running `fn`
+   */
+  template <typename Fn> uint64_t count(Fn&& fn) {
+#if defined(__linux__)
+    if (m_fd >= 0) {
+      ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+      fn();
+      ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+
+      uint64_t instructions = 0;
+      if (read(m_fd, &instructions, sizeof(instructions)) == sizeof(instructions)) {
+        return instructions;
+      }
+      return 0;
+    }
+#endif
+    fn();
+    return 0;
+  }
+};
+
+}; // namespace mutils::bench
@@ -0,0 +1,80 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+//
+// Cost of formatting a typical log line with mutils::format_to,
+// compared to the common alternatives
+//
+
+#include "./bench.h"
+#include "mutils/format.h"
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+using namespace mutils;
+
+template <typename Fn> static void report(char const* name, Fn&& fn) {
+  std::printf("%-28s %8.1f ns\n", name, bench::measure_ns(fn));
+}
+
+int main() {
+  std::string user    = "alice";
+  int         request = 48213;
+  double      latency = 12.625;
+  long        bytes   = 1048576;
+
+  StringBuffer<> buffer;
+  report("format_to (StringBuffer)", [&] {
+    buffer.clear();
+    format_to(buffer, "user {} request {} took {}ms ({} bytes)", user, request, latency, bytes);
+    bench::do_not_optimize(buffer);
+  });
+
+  std::string reused;
+  report("format_to (std::string)", [&] {
+    reused.clear();
+    format_to(reused, "user {} request {} took {}ms ({} bytes)", user, request, latency, bytes);
+    bench::do_not_optimize(reused);
+  });
+
+  report("format", [&] {
+    bench::do_not_optimize(format("user {} request {} took {}ms ({} bytes)", user, request, latency, bytes));
+  });
+
+  char line[256];
+  report("snprintf", [&] {
+    std::snprintf(line, sizeof(line), "user %s request %d took %gms (%ld bytes)", user.c_str(), request, latency, bytes);
+    bench::do_not_optimize(line);
+  });
+
+  report("std::string concatenation", [&] {
+    bench::do_not_optimize("user " + user + " request " + std::to_string(request) + " took " +
+                           std::to_string(latency) + "ms (" + std::to_string(bytes) + " bytes)");
+  });
+
+  report("std::stringstream", [&] {
+    std::stringstream ss;
+    ss << "user " << user << " request " << request << " took " << latency << "ms (" << bytes << " bytes)";
+    bench::do_not_optimize(ss.str());
+  });
+}
@@ -0,0 +1,268 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+//
+// The cost of error handling through mutils::Result, compared to exceptions,
+// std::expected (when the standard library provides it) and plain error codes
+//
+// Each strategy propagates a value (or an error) up through a chain of
+// non-inlined calls, at several depths and failure rates. Reported per call of the chain:
+// - ns/op
+// - instructions/op (when perf counters are available)
+// - the size of each strategy's machine code (its functions are grouped into their own section)
+//
+
+#include "./bench.h"
+#include "mutils/result.h"
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <version>
+
+#if defined(__cpp_lib_expected)
+#  include <expected>
+#endif
+
+using namespace mutils;
+
+// Place a strategy's functions in a named section, so its code size can be measured
+// through the linker-provided __start_/__stop_ symbols
+#define STRATEGY(name) __attribute__((noinline, used, section(name)))
+
+// Keeps the compiler from turning a chain's recursion into a loop, so every level is a real call
+#define KEEP_CALL() asm volatile("")
+
+#define SECTION_BOUNDS(name)                                                                                           \
+  extern "C" char __start_##name[];                                                                                   \
+  extern "C" char __stop_##name[];
+
+struct Error {
+  int code;
+};
+
+//
+// Each strategy is a single recursive function, `depth` calls deep
+//
+
+//
+// Error codes: the value is returned through an out-parameter
+//
+STRATEGY("bench_codes") int codes_chain(int depth, int x, int* out) {
+  if (depth == 0) {
+    if (x < 0) [[unlikely]] {
+      return x;
+    }
+    *out = x;
+    return 0;
+  }
+
+  int code = codes_chain(depth - 1, x, out);
+  KEEP_CALL();
+  if (code) [[unlikely]] {
+    return code;
+  }
+  *out += 1;
+  return 0;
+}
+
+//
+// Exceptions
+//
+STRATEGY("bench_exceptions") int exceptions_chain(int depth, int x) {
+  if (depth == 0) {
+    if (x < 0) [[unlikely]] {
+      throw Error{x};
+    }
+    return x;
+  }
+  int value = exceptions_chain(depth - 1, x);
+  KEEP_CALL();
+  return value + 1;
+}
+
+//
+// mutils::Result, propagating errors by hand
+//
+STRATEGY("bench_result") Result<int, Error> result_chain(int depth, int x) {
+  if (depth == 0) {
+    if (x < 0) [[unlikely]] {
+      return Error{x};
+    }
+    return x;
+  }
+
+  auto inner = result_chain(depth - 1, x);
+  KEEP_CALL();
+  if (!inner.is_good()) [[unlikely]] {
+    return inner;
+  }
+  return inner.peek_value() + 1;
+}
+
+//
+// mutils::Result, propagating errors through map
+//
+STRATEGY("bench_result_monadic") Result<int, Error> result_monadic_chain(int depth, int x) {
+  if (depth == 0) {
+    if (x < 0) [[unlikely]] {
+      return Error{x};
+    }
+    return x;
+  }
+  auto inner = result_monadic_chain(depth - 1, x);
+  KEEP_CALL();
+  return std::move(inner).map([](int v) { return v + 1; });
+}
+
+#if defined(__cpp_lib_expected)
+STRATEGY("bench_expected") std::expected<int, Error> expected_chain(int depth, int x) {
+  if (depth == 0) {
+    if (x < 0) [[unlikely]] {
+      return std::unexpected(Error{x});
+    }
+    return x;
+  }
+
+  auto inner = expected_chain(depth - 1, x);
+  KEEP_CALL();
+  if (!inner) [[unlikely]] {
+    return inner;
+  }
+  return *inner + 1;
+}
+
+#  if __cpp_lib_expected >= 202211L
+#    define HAVE_EXPECTED_MONADIC
+STRATEGY("bench_expected_monadic") std::expected<int, Error> expected_monadic_chain(int depth, int x) {
+  if (depth == 0) {
+    if (x < 0) [[unlikely]] {
+      return std::unexpected(Error{x});
+    }
+    return x;
+  }
+  auto inner = expected_monadic_chain(depth - 1, x);
+  KEEP_CALL();
+  return std::move(inner).transform([](int v) { return v + 1; });
+}
+#  endif
+#endif
+
+SECTION_BOUNDS(bench_codes)
+SECTION_BOUNDS(bench_exceptions)
+SECTION_BOUNDS(bench_result)
+SECTION_BOUNDS(bench_result_monadic)
+#if defined(__cpp_lib_expected)
+SECTION_BOUNDS(bench_expected)
+#endif
+#if defined(HAVE_EXPECTED_MONADIC)
+SECTION_BOUNDS(bench_expected_monadic)
+#endif
+
+// Inputs where roughly `failure_rate` of the values are errors (negative)
+static std::vector<int> make_inputs(double failure_rate) {
+  std::mt19937                     rng(7);
+  std::bernoulli_distribution      fails(failure_rate);
+  std::uniform_int_distribution<>  values(1, 1000);
+  std::vector<int>                 inputs(4096);
+  for (auto& x : inputs) {
+    x = fails(rng) ? -values(rng) : values(rng);
+  }
+  return inputs;
+}
+
+template <typename Fn> static void report(char const* name, std::vector<int> const& inputs, Fn&& op) {
+  static bench::InstructionCounter counter;
+
+  auto pass = [&] {
+    long sum = 0;
+    for (int x : inputs) {
+      sum += op(x);
+    }
+    bench::do_not_optimize(sum);
+  };
+
+  double ns = bench::measure_ns(pass, std::chrono::milliseconds(100)) / double(inputs.size());
+  if (counter.available()) {
+    double instructions = double(counter.count(pass)) / double(inputs.size());
+    std::printf("  %-28s %8.2f ns/op %8.1f instructions/op\n", name, ns, instructions);
+  } else {
+    std::printf("  %-28s %8.2f ns/op\n", name, ns);
+  }
+}
+
+static void run_depth(int depth, double failure_rate) {
+  auto inputs = make_inputs(failure_rate);
+  std::printf("depth %2d, %5.1f%% failures\n", depth, failure_rate * 100);
+
+  report("error codes", inputs, [depth](int x) {
+    int out = 0;
+    return codes_chain(depth, x, &out) ? -1 : out;
+  });
+  report("exceptions", inputs, [depth](int x) {
+    try {
+      return exceptions_chain(depth, x);
+    } catch (Error const&) {
+      return -1;
+    }
+  });
+  report("Result value_or", inputs, [depth](int x) { return result_chain(depth, x).value_or(-1); });
+  report("Result value_or_throw", inputs, [depth](int x) {
+    try {
+      return result_chain(depth, x).value_or_throw();
+    } catch (Error const&) {
+      return -1;
+    }
+  });
+  report("Result map chain", inputs, [depth](int x) { return result_monadic_chain(depth, x).value_or(-1); });
+#if defined(__cpp_lib_expected)
+  report("std::expected value_or", inputs, [depth](int x) { return expected_chain(depth, x).value_or(-1); });
+#endif
+#if defined(HAVE_EXPECTED_MONADIC)
+  report("std::expected transform chain", inputs,
+         [depth](int x) { return expected_monadic_chain(depth, x).value_or(-1); });
+#endif
+}
+
+int main() {
+  for (int depth : {1, 4, 16}) {
+    for (double rate : {0.0, 0.01, 0.5}) {
+      run_depth(depth, rate);
+    }
+  }
+
+  std::printf("\ncode size (machine code of each strategy, excluding unwind tables)\n");
+  std::printf("  %-28s %8zu B\n", "error codes", std::size_t(__stop_bench_codes - __start_bench_codes));
+  std::printf("  %-28s %8zu B\n", "exceptions", std::size_t(__stop_bench_exceptions - __start_bench_exceptions));
+  std::printf("  %-28s %8zu B\n", "Result", std::size_t(__stop_bench_result - __start_bench_result));
+  std::printf("  %-28s %8zu B\n", "Result map chain",
+              std::size_t(__stop_bench_result_monadic - __start_bench_result_monadic));
+#if defined(__cpp_lib_expected)
+  std::printf("  %-28s %8zu B\n", "std::expected", std::size_t(__stop_bench_expected - __start_bench_expected));
+#else
+  std::printf("  (std::expected is not available in this standard library)\n");
+#endif
+#if defined(HAVE_EXPECTED_MONADIC)
+  std::printf("  %-28s %8zu B\n", "std::expected transform chain",
+              std::size_t(__stop_bench_expected_monadic - __start_bench_expected_monadic));
+#endif
+}
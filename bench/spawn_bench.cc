@@ -0,0 +1,110 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+
+//
+// The rate at which short-lived child processes can be spawned
+//
+// Each strategy runs /bin/true to completion:
+// - fork + execve, building the environment from list_vars() and a lookup per variable
+// - fork + execve, with a prebuilt envp
+// - Command (posix_spawn), with a prebuilt EnvSnapshot
+//
+// The cost of fork grows with the parent's resident memory (its page tables are copied),
+// so each strategy is measured with a small parent, and again after growing it
+// (by 512 MiB, or the number of MiB given as the first argument)
+//
+
+#include "./bench.h"
+#include "mutils/env.h"
+#include "mutils/process.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace mutils;
+
+static char const* const TRUE_ARGV[] = {"/bin/true", nullptr};
+
+static void fork_exec(char* const* envp) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    execve(TRUE_ARGV[0], const_cast<char* const*>(TRUE_ARGV), envp);
+    _exit(127);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+}
+
+// Builds the child's environment the way callers of ProgramEnvironment previously had to
+static void fork_exec_listed_env() {
+  std::vector<std::string> entries;
+  for (auto const& name : env.list_vars()) {
+    char const* value = env[name];
+    entries.push_back(name + "=" + (value ? value : ""));
+  }
+
+  std::vector<char*> envp;
+  for (auto& entry : entries) {
+    envp.push_back(entry.data());
+  }
+  envp.push_back(nullptr);
+
+  fork_exec(envp.data());
+}
+
+static void report(char const* name, double ns) {
+  std::printf("  %-36s %10.0f spawns/s %10.1f us/spawn\n", name, 1e9 / ns, ns / 1e3);
+}
+
+static void run_all(EnvSnapshot const& snapshot, Command const& command) {
+  auto duration = std::chrono::milliseconds(500);
+
+  report("fork + execve, env from list_vars()", bench::measure_ns(fork_exec_listed_env, duration));
+  report("fork + execve, prebuilt envp", bench::measure_ns([&] { fork_exec(snapshot.envp()); }, duration));
+  report("Command (posix_spawn)", bench::measure_ns([&] { command.status().value_or_panic(); }, duration));
+}
+
+int main(int argc, char** argv) {
+  std::size_t grow_mib = argc > 1 ? std::size_t(std::atoi(argv[1])) : 512;
+
+  EnvSnapshot snapshot = env.snapshot().with({{"BENCH_OVERRIDE", "1"}});
+  Command     command  = Command(TRUE_ARGV[0]).environment(snapshot);
+
+  std::printf("small parent\n");
+  run_all(snapshot, command);
+
+  // Touch every page, so it is resident (and mapped in the page tables fork copies)
+  std::size_t bytes   = grow_mib << 20;
+  auto*       ballast = static_cast<char*>(std::malloc(bytes));
+  std::memset(ballast, 1, bytes);
+  bench::do_not_optimize(ballast[bytes / 2]);
+
+  std::printf("\nparent grown by %zu MiB\n", grow_mib);
+  run_all(snapshot, command);
+
+  std::free(ballast);
+}
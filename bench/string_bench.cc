@@ -0,0 +1,101 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+//
+// Throughput (GB/s) of the mutils::string kernels at several input lengths
+//
+
+#include "./bench.h"
+#include "mutils/string.h"
+#include <cstdio>
+#include <random>
+#include <string>
+
+using namespace mutils;
+
+static std::string make_field(std::size_t length, std::mt19937& rng) {
+  static constexpr char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ,,.";
+
+  std::string ret(length, ' ');
+  for (auto& c : ret) {
+    c = alphabet[rng() % (sizeof(alphabet) - 1)];
+  }
+
+  // Surround the content with some whitespace, so strip has work to do
+  for (std::size_t i = 0; i < length / 8; i++) {
+    ret[i]              = ' ';
+    ret[length - i - 1] = '\t';
+  }
+  return ret;
+}
+
+template <typename Fn> static void report(char const* name, std::size_t length, Fn&& fn) {
+  double ns = bench::measure_ns(fn);
+  std::printf("%-20s %10zu B %10.2f ns %8.2f GB/s\n", name, length, ns, double(length) / ns);
+}
+
+int main() {
+  std::mt19937 rng(42);
+
+  for (std::size_t length : {16, 64, 256, 4096, 65536, 1 << 20}) {
+    std::string field   = make_field(length, rng);
+    std::string scratch = field;
+
+    report("capitalize", length, [&] { bench::do_not_optimize(string::capitalize(field)); });
+    report("lowercase", length, [&] { bench::do_not_optimize(string::lowercase(field)); });
+    report("capitalize_inplace", length, [&] {
+      string::capitalize_inplace(scratch);
+      bench::do_not_optimize(scratch);
+    });
+    report("lowercase_inplace", length, [&] {
+      string::lowercase_inplace(scratch);
+      bench::do_not_optimize(scratch);
+    });
+    report("strip", length, [&] { bench::do_not_optimize(string::strip(field)); });
+    report("strip_start", length, [&] { bench::do_not_optimize(string::strip_start(field)); });
+    report("split", length, [&] { bench::do_not_optimize(string::split(field, ',')); });
+    report("split_view", length, [&] {
+      for (auto f : string::split_view(field, ',')) {
+        bench::do_not_optimize(f);
+      }
+    });
+
+    report("normalize (3 allocs)", length, [&] {
+      bench::do_not_optimize(string::split(string::lowercase(string::strip(field)), ','));
+    });
+
+    constexpr auto normalize = string::fused::strip | string::fused::lowercase | string::fused::split(',');
+    std::string                   buffer;
+    std::vector<std::string_view> fields;
+    report("normalize (fused)", length, [&] {
+      normalize(field, buffer, fields);
+      bench::do_not_optimize(fields);
+    });
+
+    std::string_view needles[] = {"secret", "password", "token"};
+    report("find (absent)", length, [&] { bench::do_not_optimize(string::find(field, "secret")); });
+    report("std find (absent)", length, [&] { bench::do_not_optimize(std::string_view(field).find("secret")); });
+    report("contains_any (3)", length, [&] { bench::do_not_optimize(string::contains_any(field, needles)); });
+    report("replace_all", length, [&] { bench::do_not_optimize(string::replace_all(field, ",", "<sep>")); });
+    std::printf("\n");
+  }
+}
@@ -23,32 +23,266 @@
 #pragma once
 #include "./panic.h"
 #include "./stringify.h"
+#include <atomic>
+#include <cstdint>
 #include <string>
-#ifndef NDEBUG
+#include <string_view>
+#include <type_traits>
 
-// Debug mode is on
-#  define COMPTIME_STRINGIFY_DETAIL(x) #x
-#  define COMPTIME_STRINGIFY(x) COMPTIME_STRINGIFY_DETAIL(x)
+namespace mutils::detail {
 
-#  define MUTILS_ASSERTION_ERROR(condition, ASSERTION_REASON, errmsg)                                                  \
-    if (!(condition)) {                                                                                                \
-      const auto message = std::string("[[Assertion Error @ " __FILE__ ":" COMPTIME_STRINGIFY(__LINE__) " ]] :: ") +   \
-                           std::string(ASSERTION_REASON) + "\n\t" + std::string(errmsg);                               \
-      mutils::PANIC(message);                                                                                          \
+//
+// What is known about an assertion at compile time, passed to the failure handlers
+// as string literals so the call site only needs to load two addresses
+//
+struct AssertionSite {
+  char const* location; // `file:line`
+  char const* reason;   // i.e `MUTILS_ASSERT.true x > 0`, or `MUTILS_ASSERT.equal( a, b )`
+};
+
+inline void assertion_header_to(std::string& message, AssertionSite site) {
+  message += "[[Assertion Error @ ";
+  message += site.location;
+  message += " ]] :: ";
+  message += site.reason;
+}
+
+//
+// Failure handlers, the message is only built once an assertion has failed,
+// so none of the formatting code is expanded into the (hot) calling function
+//
+[[noreturn, gnu::cold, gnu::noinline]] inline void assertion_failed(AssertionSite site, std::string_view errmsg) {
+  std::string message;
+  assertion_header_to(message, site);
+  message += "\n\t";
+  message += errmsg;
+  PANIC(std::move(message));
+}
+
+// Small operands are passed by value, a reference would force the call site
+// to keep them in memory (on every iteration of a loop, not just on failure)
+template <typename T>
+using assertion_operand_t =
+    std::conditional_t<std::is_trivially_copyable_v<T> && sizeof(T) <= 2 * sizeof(void*), T, T const&>;
+
+template <typename A, typename B>
+[[noreturn, gnu::cold, gnu::noinline]] void binary_assertion_failed(AssertionSite          site,
+                                                                    char const*            operator_symbol,
+                                                                    assertion_operand_t<A> a,
+                                                                    assertion_operand_t<B> b,
+                                                                    std::string_view       errmsg) {
+  std::string message;
+  assertion_header_to(message, site);
+  message += "  -> [";
+  stringify_to(message, a);
+  message += ' ';
+  message += operator_symbol;
+  message += ' ';
+  stringify_to(message, b);
+  message += "] evaluated to false\n\t";
+  message += errmsg;
+  PANIC(std::move(message));
+}
+
+
+//
+// A call site of an assertion in the sampled mode, which counts its hits
+// and only checks every MUTILS_ASSERT_SAMPLE_PERIOD'th one
+//
+// Sites are constant-initialized, and are linked into a registry (for reporting)
+// the first time they are checked. Hits are counted without read-modify-write
+// atomics, concurrent hits may occasionally be lost, which only shifts the sampling
+//
+struct SampledAssertionSite {
+  AssertionSite         site;
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> checks{0};
+  std::atomic<bool>     registered{false};
+  SampledAssertionSite* next = nullptr;
+
+  constexpr SampledAssertionSite(AssertionSite s) : site(s) {
+  }
+};
+
+inline std::atomic<SampledAssertionSite*> sampled_assertion_sites{nullptr};
+
+[[gnu::cold, gnu::noinline]] inline void register_sampled_assertion(SampledAssertionSite& site) {
+  if (site.registered.exchange(true, std::memory_order_relaxed)) {
+    return;
+  }
+  site.next = sampled_assertion_sites.load(std::memory_order_relaxed);
+  while (!sampled_assertion_sites.compare_exchange_weak(
+      site.next, &site, std::memory_order_release, std::memory_order_relaxed)) {
+  }
+}
+
+// Count a hit, returning whether this one should be checked
+template <uint64_t Period> inline bool sample_assertion(SampledAssertionSite& site) {
+  uint64_t hit = site.hits.load(std::memory_order_relaxed);
+  site.hits.store(hit + 1, std::memory_order_relaxed);
+  if (__builtin_expect(hit % Period != 0, 1)) {
+    return false;
+  }
+
+  if (!site.registered.load(std::memory_order_relaxed)) [[unlikely]] {
+    register_sampled_assertion(site);
+  }
+  site.checks.store(site.checks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  return true;
+}
+
+}; // namespace mutils::detail
+
+namespace mutils {
+
+//
+// The counters of an assertion site in the sampled mode
+//
+struct SampledAssertionStats {
+  char const* location; // `file:line`
+  char const* reason;
+  uint64_t    hits;   // the number of times the assertion was reached
+  uint64_t    checks; // the number of times its condition was evaluated
+};
+
+//
+// Visit the counters of every sampled assertion site which has been reached
+// (sites are visited most recently reached first)
+//
+template <typename Fn> void for_each_sampled_assertion(Fn&& fn) {
+  auto* site = detail::sampled_assertion_sites.load(std::memory_order_acquire);
+  for (; site; site = site->next) {
+    fn(SampledAssertionStats{site->site.location,
+                             site->site.reason,
+                             site->hits.load(std::memory_order_relaxed),
+                             site->checks.load(std::memory_order_relaxed)});
+  }
+}
+
+//
+// A summary of every sampled assertion site, one per line
+//
+inline std::string sampled_assertion_report() {
+  std::string report;
+  for_each_sampled_assertion([&](SampledAssertionStats const& stats) {
+    report += stats.location;
+    report += ": ";
+    report += stats.reason;
+    report += " (";
+    stringify_to(report, stats.checks);
+    report += " of ";
+    stringify_to(report, stats.hits);
+    report += " hits checked)\n";
+  });
+  return report;
+}
+
+}; // namespace mutils
+
+//
+// Assertion modes, select one by defining MUTILS_ASSERT_MODE before including this header:
+//
+// - MUTILS_ASSERT_MODE_CHECK: every assertion is checked (the default, unless NDEBUG is defined)
+// - MUTILS_ASSERT_MODE_OFF: assertions (and their operands) are not evaluated (the default under NDEBUG)
+// - MUTILS_ASSERT_MODE_ASSUME: assertions are not checked, instead the optimizer may assume
+//   they hold. A false assumption is undefined behaviour, and outside of clang (`__builtin_assume`)
+//   the condition is still evaluated for any side effects it may have, so keep conditions cheap and pure
+// - MUTILS_ASSERT_MODE_SAMPLED: each call site only checks every MUTILS_ASSERT_SAMPLE_PERIOD'th
+//   time it is reached (the first is always checked), bounding the cost of checks in production.
+//   Counts are reported through `for_each_sampled_assertion` and `sampled_assertion_report`
+//
+// Assertions reached during constant evaluation are always checked (a failure is a compile error)
+//
+#define MUTILS_ASSERT_MODE_OFF 0
+#define MUTILS_ASSERT_MODE_CHECK 1
+#define MUTILS_ASSERT_MODE_ASSUME 2
+#define MUTILS_ASSERT_MODE_SAMPLED 3
+
+#ifndef MUTILS_ASSERT_MODE
+#  ifdef NDEBUG
+#    define MUTILS_ASSERT_MODE MUTILS_ASSERT_MODE_OFF
+#  else
+#    define MUTILS_ASSERT_MODE MUTILS_ASSERT_MODE_CHECK
+#  endif
+#endif
+
+#ifndef MUTILS_ASSERT_SAMPLE_PERIOD
+#  define MUTILS_ASSERT_SAMPLE_PERIOD 64
+#endif
+
+#if defined(__clang__)
+#  define MUTILS_ASSUME(condition) __builtin_assume(condition)
+#elif defined(__has_cpp_attribute) && __has_cpp_attribute(assume)
+#  define MUTILS_ASSUME(condition) [[assume(condition)]]
+#else
+#  define MUTILS_ASSUME(condition)                                                                                      \
+    do {                                                                                                                \
+      if (!(condition)) {                                                                                               \
+        __builtin_unreachable();                                                                                        \
+      }                                                                                                                 \
+    } while (0)
+#endif
+
+#define COMPTIME_STRINGIFY_DETAIL(x) #x
+#define COMPTIME_STRINGIFY(x) COMPTIME_STRINGIFY_DETAIL(x)
+
+#if MUTILS_ASSERT_MODE == MUTILS_ASSERT_MODE_SAMPLED
+
+// Whether this hit of the call site should be checked, each expansion declares its own counters
+#  define MUTILS_ASSERTION_SAMPLE(ASSERTION_REASON)                                                                    \
+    (std::is_constant_evaluated() ||                                                                                   \
+     mutils::detail::sample_assertion<MUTILS_ASSERT_SAMPLE_PERIOD>(                                                    \
+         []() -> mutils::detail::SampledAssertionSite& {                                                               \
+           static constinit mutils::detail::SampledAssertionSite site{MUTILS_ASSERTION_SITE(ASSERTION_REASON)};        \
+           return site;                                                                                                \
+         }()))
+#else
+#  define MUTILS_ASSERTION_SAMPLE(ASSERTION_REASON) true
+#endif
+
+#if MUTILS_ASSERT_MODE == MUTILS_ASSERT_MODE_CHECK || MUTILS_ASSERT_MODE == MUTILS_ASSERT_MODE_SAMPLED
+
+#  define MUTILS_ASSERTION_SITE(ASSERTION_REASON)                                                                      \
+    mutils::detail::AssertionSite {                                                                                    \
+      __FILE__ ":" COMPTIME_STRINGIFY(__LINE__), ASSERTION_REASON                                                      \
     }
 
+#  define MUTILS_ASSERTION_ERROR(condition, ASSERTION_REASON, errmsg)                                                   \
+    do {                                                                                                                \
+      if (MUTILS_ASSERTION_SAMPLE(ASSERTION_REASON) && __builtin_expect(!(condition), 0)) {                             \
+        mutils::detail::assertion_failed(MUTILS_ASSERTION_SITE(ASSERTION_REASON), errmsg);                              \
+      }                                                                                                                 \
+    } while (0)
+
+#  define MUTILS_BINARY_ASSERTION_ERROR(a, b, operator_name, operator_symbol, errmsg)                                   \
+    do {                                                                                                                \
+      if (MUTILS_ASSERTION_SAMPLE(MUTILS_BINARY_ASSERTION_REASON(a, b, operator_name))) {                               \
+        auto __$a_eval = a;                                                                                             \
+        auto __$b_eval = b;                                                                                             \
+        if (__builtin_expect(!(__$a_eval operator_symbol __$b_eval), 0)) {                                              \
+          mutils::detail::binary_assertion_failed<decltype(__$a_eval), decltype(__$b_eval)>(                            \
+              MUTILS_ASSERTION_SITE(MUTILS_BINARY_ASSERTION_REASON(a, b, operator_name)),                               \
+              #operator_symbol,                                                                                         \
+              __$a_eval,                                                                                                \
+              __$b_eval,                                                                                                \
+              errmsg);                                                                                                  \
+        }                                                                                                               \
+      }                                                                                                                 \
+    } while (0)
+
+#elif MUTILS_ASSERT_MODE == MUTILS_ASSERT_MODE_ASSUME
+
+#  define MUTILS_ASSERTION_ERROR(condition, ASSERTION_REASON, errmsg) MUTILS_ASSUME(condition)
+
 #  define MUTILS_BINARY_ASSERTION_ERROR(a, b, operator_name, operator_symbol, errmsg)                                  \
-    {                                                                                                                  \
-      auto __$a_eval = a;                                                                                              \
-      auto __$b_eval = b;                                                                                              \
-      MUTILS_ASSERTION_ERROR(__$a_eval operator_symbol __$b_eval,                                                      \
-                             "MUTILS_ASSERT." operator_name                                                            \
-                             "( " COMPTIME_STRINGIFY(a) ", " COMPTIME_STRINGIFY(b) " )  -> [" +                        \
-                                 mutils::stringify(__$a_eval) + " " #operator_symbol " " +                             \
-                                 mutils::stringify(__$b_eval) + "] evaluated to false",                                \
-                             errmsg);                                                                                  \
-    }
+    MUTILS_ASSUME((a)operator_symbol(b))
+
+#endif
+
+#define MUTILS_BINARY_ASSERTION_REASON(a, b, operator_name)                                                            \
+  "MUTILS_ASSERT." operator_name "( " COMPTIME_STRINGIFY(a) ", " COMPTIME_STRINGIFY(b) " )"
 
+#if MUTILS_ASSERT_MODE != MUTILS_ASSERT_MODE_OFF
 
 #  define MUTILS_ASSERT(expr, error)                                                                                   \
     MUTILS_ASSERTION_ERROR((bool)(expr), "MUTILS_ASSERT.true " COMPTIME_STRINGIFY(expr), error)
@@ -0,0 +1,228 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+//
+// delimited.h
+//
+// A tokenizer for delimited records (CSV, TSV, etc.), with in-place numeric parsing
+//
+
+#pragma once
+
+#include "./file.h"
+#include "./result.h"
+#include <charconv>
+#include <concepts>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace mutils {
+
+//
+// Describes the layout of a delimited text format
+//
+struct RecordFormat {
+  char delimiter = ',';
+
+  // Fields may be wrapped in this character, allowing them to contain
+  // delimiters and newlines. '\0' disables quoting
+  char quote = '"';
+
+  // If equal to `quote`, a doubled quote within a quoted field is a literal quote (RFC 4180).
+  // Otherwise the character escapes the one after it (\t, \n and \r are translated).
+  // '\0' disables escaping
+  char escape = '"';
+
+  static constexpr RecordFormat csv() {
+    return RecordFormat{',', '"', '"'};
+  }
+
+  static constexpr RecordFormat tsv() {
+    return RecordFormat{'\t', '\0', '\\'};
+  }
+};
+
+//
+// Reads records from delimited text one at a time
+//
+// The fields of the current record are views, either directly into the
+// source data or (for every field of a record which contains quotes or
+// escapes) into a buffer owned by the reader. They remain valid until the next call to `next()`
+//
+// Both LF and CRLF line endings are accepted, a blank line is a record with no fields
+//
+class RecordReader {
+public:
+  RecordReader(std::string_view data, RecordFormat format = RecordFormat::csv()) : m_data(data), m_format(format) {
+  }
+
+  RecordReader(TextFile const& file, RecordFormat format = RecordFormat::csv()) :
+      RecordReader(file.content(), format) {
+  }
+
+  /**
+   * Advance to the next record, returns false once the data is exhausted
+   */
+  bool next();
+
+  /**
+   * Skip over the next `n` records (i.e a header row)
+   */
+  void skip(std::size_t n = 1) {
+    while (n-- && next()) {
+    }
+  }
+
+  /**
+   * The fields of the current record
+   */
+  std::span<std::string_view const> fields() const {
+    return m_fields;
+  }
+
+  std::string_view operator[](std::size_t column) const {
+    return m_fields[column];
+  }
+
+  /**
+   * The zero-based index of the current record
+   */
+  std::size_t record_index() const {
+    return m_record - 1;
+  }
+
+  /**
+   * Parse a field of the current record as a number
+   */
+  template <typename T> std::optional<T> field_as(std::size_t column) const;
+
+private:
+  // A field within the scratch buffer, views are only taken once the
+  // record is complete, as the buffer may reallocate while it is built
+  struct FieldSpan {
+    std::size_t offset;
+    std::size_t length;
+  };
+
+  void m_next_plain(std::string_view line);
+  void m_next_quoted();
+
+  std::string_view              m_data;
+  RecordFormat                  m_format;
+  std::size_t                   m_cursor = 0;
+  std::size_t                   m_record = 0;
+  std::vector<std::string_view> m_fields;
+  std::vector<FieldSpan>        m_spans;
+  std::string                   m_scratch;
+};
+
+//
+// Parse an entire field as a number, using std::from_chars
+//
+// returns nothing if the field is not a number, or has trailing characters
+//
+template <typename T>
+  requires std::integral<T> || std::floating_point<T>
+std::optional<T> parse_number(std::string_view field) {
+  T value;
+
+  char const* first = field.data();
+  char const* last  = field.data() + field.size();
+
+  // from_chars rejects a leading '+', which is common in exported data
+  // (but accepts a '-', which must not follow it)
+  if (first != last && *first == '+') {
+    first++;
+    if (first != last && *first == '-') {
+      return std::nullopt;
+    }
+  }
+
+  auto [ptr, ec] = std::from_chars(first, last, value);
+  if (ec != std::errc() || ptr != last) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+template <typename T> std::optional<T> RecordReader::field_as(std::size_t column) const {
+  if (column >= m_fields.size()) {
+    return std::nullopt;
+  }
+  return parse_number<T>(m_fields[column]);
+}
+
+//
+// Describes why a column could not be parsed
+//
+struct RecordError {
+  enum Kind {
+    MissingField, // The record has too few fields
+    InvalidValue, // The field is not a valid number
+  } kind;
+
+  std::size_t record; // The zero-based index of the record
+  std::size_t column;
+};
+
+//
+// Parse one column of every record into a vector of numbers
+//
+// Records may be skipped from the start of the data (i.e a header row).
+// Fails on the first record which is missing the column, or has an invalid value
+//
+template <typename T>
+Result<std::vector<T>, RecordError> parse_column(std::string_view data,
+                                                 std::size_t      column,
+                                                 RecordFormat     format       = RecordFormat::csv(),
+                                                 std::size_t      skip_records = 0) {
+  RecordReader reader(data, format);
+  reader.skip(skip_records);
+
+  std::vector<T> values;
+  while (reader.next()) {
+    auto fields = reader.fields();
+    if (column >= fields.size()) {
+      return RecordError{RecordError::MissingField, reader.record_index(), column};
+    }
+    auto value = parse_number<T>(fields[column]);
+    if (!value) {
+      return RecordError{RecordError::InvalidValue, reader.record_index(), column};
+    }
+    values.push_back(*value);
+  }
+  return values;
+}
+
+template <typename T>
+Result<std::vector<T>, RecordError> parse_column(TextFile const& file,
+                                                 std::size_t     column,
+                                                 RecordFormat    format       = RecordFormat::csv(),
+                                                 std::size_t     skip_records = 0) {
+  return parse_column<T>(file.content(), column, format, skip_records);
+}
+
+}; // namespace mutils
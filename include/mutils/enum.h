@@ -0,0 +1,199 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+//
+// enum.h
+//
+// Compile-time reflection of enumerator names
+//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace mutils {
+
+//
+// The range of values which are searched for enumerators
+//
+// Specialize this for enums whose enumerators lie outside of [-128, 127]
+// (values outside of the enum's underlying type are never searched).
+// Clang rejects out-of-range casts to enums without a fixed underlying type,
+// so such enums may need a narrower range there
+//
+template <typename E> struct enum_range {
+  static constexpr long long min = -128;
+  static constexpr long long max = 127;
+};
+
+template <typename E> struct EnumEntry {
+  E                value;
+  std::string_view name;
+};
+
+namespace detail {
+
+//
+// The compiler spells out template arguments within __PRETTY_FUNCTION__,
+// as `Namespace::Enum::Name` for enumerators, or `(Namespace::Enum)5` for
+// values which do not name an enumerator
+//
+template <auto V> constexpr std::string_view enum_probe() {
+  std::string_view name = __PRETTY_FUNCTION__;
+
+#if defined(__clang__)
+  std::size_t start = name.rfind("V = ") + 4;
+  std::size_t end   = name.find(']', start);
+#elif defined(__GNUC__)
+  std::size_t start = name.rfind("V = ") + 4;
+  std::size_t end   = name.find_first_of(";]", start);
+#else
+#  error "Enum reflection requires GCC or Clang"
+#endif
+
+  name = name.substr(start, end - start);
+  if (name.empty() || name[0] == '(' || (name[0] >= '0' && name[0] <= '9') || name[0] == '-') {
+    return {};
+  }
+  return name.substr(name.rfind(':') + 1);
+}
+
+template <typename E> constexpr long long enum_min() {
+  using U = std::underlying_type_t<E>;
+  return std::max<long long>(enum_range<E>::min, std::numeric_limits<U>::min());
+}
+
+template <typename E> constexpr long long enum_max() {
+  using U = std::underlying_type_t<E>;
+  // The maximum of a 64-bit unsigned type does not fit in a long long (which the range always does)
+  if constexpr (std::is_unsigned_v<U> && sizeof(U) >= sizeof(long long)) {
+    return enum_range<E>::max;
+  } else {
+    return std::min<long long>(enum_range<E>::max, (long long)std::numeric_limits<U>::max());
+  }
+}
+
+template <typename E, std::size_t... Is> constexpr auto enum_probe_all(std::index_sequence<Is...>) {
+  return std::array<std::string_view, sizeof...(Is)>{enum_probe<static_cast<E>(enum_min<E>() + (long long)Is)>()...};
+}
+
+// The name of every value in the searched range, empty where there is no enumerator
+template <typename E>
+inline constexpr auto enum_probed =
+    enum_probe_all<E>(std::make_index_sequence<std::size_t(enum_max<E>() - enum_min<E>() + 1)>());
+
+template <typename E> constexpr std::size_t enum_count() {
+  std::size_t count = 0;
+  for (auto name : enum_probed<E>) {
+    count += !name.empty();
+  }
+  return count;
+}
+
+// Every enumerator, in order of value
+template <typename E> inline constexpr auto enum_entries = [] {
+  std::array<EnumEntry<E>, enum_count<E>()> entries{};
+  std::size_t                               k = 0;
+  for (std::size_t i = 0; i < enum_probed<E>.size(); i++) {
+    if (!enum_probed<E>[i].empty()) {
+      entries[k++] = {static_cast<E>(enum_min<E>() + (long long)i), enum_probed<E>[i]};
+    }
+  }
+  return entries;
+}();
+
+// Every enumerator, in order of name (for binary searches by name)
+template <typename E> inline constexpr auto enum_entries_by_name = [] {
+  auto entries = enum_entries<E>;
+  std::sort(entries.begin(), entries.end(), [](auto const& a, auto const& b) { return a.name < b.name; });
+  return entries;
+}();
+
+// The span of values from the smallest to the largest enumerator
+template <typename E> constexpr long long enum_first() {
+  return enum_entries<E>.empty() ? 0 : (long long)enum_entries<E>.front().value;
+}
+
+template <typename E> constexpr long long enum_last() {
+  return enum_entries<E>.empty() ? -1 : (long long)enum_entries<E>.back().value;
+}
+
+// Names indexed by (value - first enumerator), so lookups by value are a single index
+template <typename E> inline constexpr auto enum_names_by_value = [] {
+  std::array<std::string_view, std::size_t(enum_last<E>() - enum_first<E>() + 1)> names;
+  names.fill(std::string_view());
+  for (auto entry : enum_entries<E>) {
+    names[std::size_t((long long)entry.value - enum_first<E>())] = entry.name;
+  }
+  return names;
+}();
+
+}; // namespace detail
+
+//
+// Every enumerator of `E`, along with its name, ordered by value
+//
+template <typename E>
+  requires std::is_enum_v<E>
+constexpr std::span<EnumEntry<E> const> enum_entries() {
+  return detail::enum_entries<E>;
+}
+
+//
+// The name of an enumerator, or an empty view if `value` does not name one
+// (values which name several enumerators yield the first)
+//
+template <typename E>
+  requires std::is_enum_v<E>
+constexpr std::string_view enum_name(E value) {
+  auto offset = (long long)value - detail::enum_first<E>();
+  if (offset < 0 || offset >= (long long)detail::enum_names_by_value<E>.size()) {
+    return {};
+  }
+  return detail::enum_names_by_value<E>[std::size_t(offset)];
+}
+
+//
+// Find the enumerator with the given name
+//
+template <typename E>
+  requires std::is_enum_v<E>
+constexpr std::optional<E> parse(std::string_view name) {
+  auto const& entries = detail::enum_entries_by_name<E>;
+
+  auto it = std::lower_bound(
+      entries.begin(), entries.end(), name, [](EnumEntry<E> const& entry, std::string_view n) { return entry.name < n; });
+  if (it == entries.end() || it->name != name) {
+    return std::nullopt;
+  }
+  return it->value;
+}
+
+}; // namespace mutils
@@ -22,11 +22,257 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace mutils {
 
+//
+// An immutable copy of a set of environment variables, indexed by name
+//
+// The variables are copied into a single buffer when the snapshot is built,
+// after which lookups are a hash and a probe, and never touch the process
+// environment (so are unaffected by, and safe alongside, concurrent setenv calls).
+// Copies of a snapshot share the same data
+//
+class EnvSnapshot {
+public:
+  struct Variable {
+    std::string_view name;
+    std::string_view value;
+  };
+
+  /**
+   * An empty environment
+   */
+  EnvSnapshot();
+
+  /**
+   * Build a snapshot from a list of variables, if a name appears more than once the first is kept
+   */
+  explicit EnvSnapshot(std::span<Variable const> variables);
+
+  /**
+   * Snapshot the environment of the current process
+   */
+  static EnvSnapshot capture();
+
+  /**
+   * A copy of this snapshot with the given variables set (added, or replacing their current values)
+   */
+  EnvSnapshot with(std::span<Variable const> overrides) const;
+
+  EnvSnapshot with(std::initializer_list<Variable> overrides) const {
+    return with(std::span(overrides.begin(), overrides.size()));
+  }
+
+  /**
+   * A copy of this snapshot without the given variables
+   */
+  EnvSnapshot without(std::span<std::string_view const> names) const;
+
+  /**
+   * The value of a variable, if it is set
+   */
+  std::optional<std::string_view> get(std::string_view name) const {
+    if (auto* var = m_find(name)) {
+      return var->value;
+    }
+    return std::nullopt;
+  }
+
+  bool contains(std::string_view name) const {
+    return m_find(name) != nullptr;
+  }
+
+  //
+  // Typed lookups, which return nothing if the variable is unset or fails to parse
+  // (surrounding whitespace is ignored)
+  //
+
+  /**
+   * A decimal integer, optionally signed
+   */
+  std::optional<int64_t> get_int(std::string_view name) const;
+
+  /**
+   * `1`, `true`, `yes` or `on`, and `0`, `false`, `no` or `off` (in any case)
+   */
+  std::optional<bool> get_bool(std::string_view name) const;
+
+  /**
+   * A sequence of numbers, each followed by a unit of `ns`, `us`, `ms`, `s`, `m` or `h`, i.e `1m30s` or `2.5ms`
+   */
+  std::optional<std::chrono::nanoseconds> get_duration(std::string_view name) const;
+
+  /**
+   * A number of bytes, optionally followed by a binary multiple `K`, `M`, `G` or `T`
+   * (in any case, and optionally suffixed with `B` or `iB`), i.e `512`, `64k` or `16MiB`
+   */
+  std::optional<uint64_t> get_size(std::string_view name) const;
+
+  /**
+   * Every variable, in the order of the environment
+   */
+  std::span<Variable const> variables() const {
+    return m_table->variables;
+  }
+
+  Variable const* begin() const {
+    return m_table->variables.data();
+  }
+
+  Variable const* end() const {
+    return m_table->variables.data() + m_table->variables.size();
+  }
+
+  std::size_t size() const {
+    return m_table->variables.size();
+  }
+
+  /**
+   * The variables as a null-terminated array of `NAME=value` strings, as taken by exec and posix_spawn
+   */
+  char* const* envp() const {
+    return const_cast<char* const*>(m_table->envp.data());
+  }
+
+private:
+  //
+  // Each variable is stored as `NAME=value\0`, so `envp` can point into the same buffer.
+  // Names are indexed by an open-addressing table of (variable index + 1), 0 marks an empty slot
+  //
+  struct Table {
+    std::unique_ptr<char[]>  storage;
+    std::vector<Variable>    variables;
+    std::vector<char const*> envp;
+    std::vector<uint32_t>    slots;
+    std::size_t              mask = 0;
+  };
+
+  static uint64_t hash(std::string_view s) {
+    return std::hash<std::string_view>{}(s) * 0x9E3779B97F4A7C15ull;
+  }
+
+  Variable const* m_find(std::string_view name) const {
+    Table const& table = *m_table;
+    for (std::size_t i = hash(name) & table.mask;; i = (i + 1) & table.mask) {
+      uint32_t slot = table.slots[i];
+      if (slot == 0) {
+        return nullptr;
+      }
+      if (table.variables[slot - 1].name == name) {
+        return &table.variables[slot - 1];
+      }
+    }
+  }
+
+  friend class ManagedEnvironment;
+
+  explicit EnvSnapshot(std::shared_ptr<Table const> table) : m_table(std::move(table)) {
+  }
+
+  std::shared_ptr<Table const> m_table;
+};
+
+//
+// An environment owned by mutils, which is safe to read and modify from any thread
+//
+// setenv/unsetenv are not safe alongside concurrent getenv calls, so rather than
+// writing to the process environment, changes are made here and published as new
+// versions (copy-on-write). Readers take a consistent snapshot without locking,
+// and keep using it for as long as they like, however many versions are published after it.
+//
+// Writers are serialized among themselves, and never block readers. Readers register in
+// one of two epochs, and a replaced version is freed once both epochs have been advanced
+// past the one it was retired in, so no reader which could have loaded it is left. Epochs
+// are advanced on each publish, and on snapshots while versions are waiting to be freed,
+// so a version is kept only as long as the readers which were already running when it was
+// replaced (readers which have taken a snapshot share ownership of its data, so are unaffected)
+//
+class ManagedEnvironment {
+public:
+  /**
+   * Start from a snapshot of the process environment
+   */
+  ManagedEnvironment();
+  explicit ManagedEnvironment(EnvSnapshot initial);
+  ~ManagedEnvironment();
+
+  ManagedEnvironment(ManagedEnvironment const&)            = delete;
+  ManagedEnvironment& operator=(ManagedEnvironment const&) = delete;
+
+  /**
+   * The current version of the environment (lock-free)
+   */
+  EnvSnapshot snapshot() const;
+
+  /**
+   * The number of versions which have been published since construction
+   */
+  uint64_t version() const {
+    return m_version.load(std::memory_order_acquire);
+  }
+
+  //
+  // Each of these publishes a single new version
+  //
+
+  void set(std::string_view name, std::string_view value);
+  void set(std::span<EnvSnapshot::Variable const> variables);
+  void unset(std::string_view name);
+  void unset(std::span<std::string_view const> names);
+  void clear();
+  void reset(EnvSnapshot snapshot);
+
+  /**
+   * Make the process environment match the current version
+   *
+   * This is the one place which writes to the process environment, so it
+   * must not race with getenv/setenv on other threads. Call it at a point where
+   * no other thread reads the process environment (i.e before starting threads which
+   * do, or before a child process which inherits `environ` is spawned)
+   */
+  void sync_to_process() const;
+
+private:
+  using Version = std::shared_ptr<EnvSnapshot::Table const>;
+
+  void m_publish(EnvSnapshot next);
+  void m_reclaim() const;
+
+  // The current version, only replaced (never modified) by writers
+  std::atomic<Version*> m_current;
+
+  // Readers are counted in the parity of the epoch they started in, between loading `m_current`
+  // and copying the version it points to. The epoch is only advanced once the readers of the
+  // previous one have finished, so every active reader is in the current epoch or the one before it
+  mutable std::atomic<uint64_t> m_epoch{0};
+  mutable std::atomic<uint64_t> m_readers[2]{};
+
+  std::atomic<uint64_t> m_version{0};
+
+  // A replaced version, and the epoch it was replaced in
+  struct Retired {
+    Version* version;
+    uint64_t epoch;
+  };
+
+  mutable std::mutex               m_write_lock;
+  mutable std::vector<Retired>     m_retired;
+  mutable std::atomic<std::size_t> m_retired_count{0};
+};
+
 struct ProgramEnvironment {
 
   struct EnvEntry {
@@ -53,6 +299,11 @@ struct ProgramEnvironment {
   void clear();
 
   std::vector<std::string> list_vars();
+
+  /**
+   * Take an immutable, indexed copy of the environment (see EnvSnapshot)
+   */
+  EnvSnapshot snapshot();
 };
 
 inline ProgramEnvironment env;
@@ -0,0 +1,167 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+//
+// error_context.h
+//
+// Context which is attached to errors as they propagate, and only formatted when displayed
+//
+
+#pragma once
+
+#include "./format.h"
+#include "./result.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+namespace mutils {
+
+namespace detail {
+
+// Arrays (i.e string literals) are captured as pointers to their first element
+template <typename A>
+using context_capture_t = std::conditional_t<std::is_array_v<A>, std::remove_extent_t<A> const*, A>;
+
+template <typename Captured> void render_context_frame(std::string& out, std::string_view fmt, std::byte const* data) {
+  auto const& args = *std::launder(reinterpret_cast<Captured const*>(data));
+  std::apply([&](auto const&... captured) { format_unchecked_to(out, fmt, captured...); }, args);
+}
+
+}; // namespace detail
+
+//
+// A chain of context messages, attached to an error as it propagates
+//
+// Each message is a compile-time checked format string (of which only a view is kept)
+// plus its arguments, copied into a small inline buffer. Nothing is allocated or
+// formatted until the chain is rendered as text, so errors which are handled (i.e retried)
+// without being displayed never touch the heap
+//
+// Arguments must be trivially copyable: strings should be passed as literals, or as
+// string_views which outlive the error. Once `Frames` messages (or `ArgBytes` bytes of
+// arguments) are held, further context is counted but dropped. Raise them for deeper
+// chains, at the cost of a larger error (and so a larger Result)
+//
+template <std::size_t Frames = 3, std::size_t ArgBytes = 64> class ErrorContext {
+  struct Frame {
+    char const* fmt;
+    void (*render)(std::string& out, std::string_view fmt, std::byte const* data);
+    uint32_t fmt_size;
+    uint32_t offset;
+  };
+
+  alignas(std::max_align_t) std::array<std::byte, ArgBytes> m_args;
+  std::array<Frame, Frames>                                 m_frames;
+  uint32_t                                                  m_count   = 0;
+  uint32_t                                                  m_used    = 0;
+  uint32_t                                                  m_dropped = 0;
+
+public:
+  /**
+   * Attach a message to the chain, the most recently attached is the outermost
+   */
+  template <typename... Args> void add(FormatString<std::type_identity_t<Args>...> fmt, Args const&... args) {
+    using Captured = std::tuple<detail::context_capture_t<Args>...>;
+    static_assert((std::is_trivially_copyable_v<detail::context_capture_t<Args>> && ...),
+                  "Error context arguments are captured by value, and must be trivially copyable "
+                  "(pass strings as string literals or std::string_view)");
+
+    std::size_t offset = (m_used + alignof(Captured) - 1) / alignof(Captured) * alignof(Captured);
+    if (m_count == Frames || offset + sizeof(Captured) > ArgBytes) [[unlikely]] {
+      m_dropped++;
+      return;
+    }
+
+    ::new (static_cast<void*>(m_args.data() + offset)) Captured(args...);
+    m_frames[m_count++] = {fmt.view().data(), &detail::render_context_frame<Captured>, uint32_t(fmt.view().size()),
+                           uint32_t(offset)};
+    m_used              = uint32_t(offset + sizeof(Captured));
+  }
+
+  std::size_t size() const {
+    return m_count;
+  }
+
+  /**
+   * The number of messages which did not fit
+   */
+  std::size_t dropped() const {
+    return m_dropped;
+  }
+
+  /**
+   * Render the chain, outermost message first, each followed by ": "
+   */
+  void render_to(std::string& out) const {
+    // Dropped messages were attached last, so are the outermost
+    if (m_dropped) {
+      format_to(out, "({} more): ", m_dropped);
+    }
+    for (std::size_t i = m_count; i-- > 0;) {
+      auto const& frame = m_frames[i];
+      frame.render(out, std::string_view(frame.fmt, frame.fmt_size), m_args.data() + frame.offset);
+      out.append(": ");
+    }
+  }
+};
+
+//
+// An error, along with the context it has gathered while propagating
+//
+// Use as the error type of a Result, and attach context with `Result::with_context`:
+//
+//   Result<Config, ContextError<ParseError>> load(std::string_view path) {
+//     return read_file(path).and_then(parse).with_context("loading config from {}", path);
+//   }
+//
+// The chain is rendered (by `toString`, stringify, or `value_or_panic`) as
+//   "loading config from app.conf: parsing line 3: <error>"
+//
+template <typename E, std::size_t Frames = 3, std::size_t ArgBytes = 64> struct ContextError {
+  E                               error;
+  ErrorContext<Frames, ArgBytes> context;
+
+  ContextError(E err) : error(std::move(err)) {
+  }
+
+  template <typename... Args>
+  void add_context(FormatString<std::type_identity_t<Args>...> fmt, Args const&... args) {
+    context.add(fmt, args...);
+  }
+
+  std::string toString() const
+    requires IsStringifiable<E>
+  {
+    std::string ret;
+    context.render_to(ret);
+    stringify_to(ret, error);
+    return ret;
+  }
+};
+
+}; // namespace mutils
@@ -230,6 +230,13 @@ struct TextFile {
     return raw_content[idx];
   }
 
+  //
+  // The entire (memory-mapped) content of the file
+  //
+  std::string_view content() const {
+    return raw_content;
+  }
+
 private:
   Path m_path;
 
@@ -0,0 +1,200 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+//
+// format.h
+//
+// `{}` format strings, checked against their arguments at compile time
+//
+
+#pragma once
+
+#include "./stringify.h"
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace mutils {
+
+namespace detail {
+
+// Deliberately not constexpr: reaching this while parsing a format string
+// at compile time turns the mistake into a compile error
+inline void format_string_error(char const* /* reason */) {
+}
+
+}; // namespace detail
+
+//
+// A format string, containing one `{}` placeholder for each of `Args`
+//
+// Format strings are parsed at compile time (a mismatched number of
+// placeholders, or a stray brace, fails to compile). `{{` and `}}` produce
+// literal braces. Only a view of the string is kept, it is never copied
+//
+template <typename... Args> class FormatString {
+  std::string_view                         m_str;
+  std::array<std::size_t, sizeof...(Args)> m_holes{}; // the offset of each placeholder
+  bool                                     m_escapes = false;
+
+public:
+  template <typename S>
+    requires std::convertible_to<S const&, std::string_view>
+  consteval FormatString(S const& str) : m_str(str) {
+    std::size_t holes = 0;
+
+    for (std::size_t i = 0; i < m_str.size(); i++) {
+      if (m_str[i] == '{') {
+        if (i + 1 < m_str.size() && m_str[i + 1] == '{') {
+          m_escapes = true;
+          i++;
+        } else if (i + 1 < m_str.size() && m_str[i + 1] == '}') {
+          if (holes == sizeof...(Args)) {
+            detail::format_string_error("the format string has more placeholders than arguments");
+          } else {
+            m_holes[holes] = i;
+          }
+          holes++;
+          i++;
+        } else {
+          detail::format_string_error("unmatched '{' in format string (use '{{' for a literal brace)");
+        }
+      } else if (m_str[i] == '}') {
+        if (i + 1 < m_str.size() && m_str[i + 1] == '}') {
+          m_escapes = true;
+          i++;
+        } else {
+          detail::format_string_error("unmatched '}' in format string (use '}}' for a literal brace)");
+        }
+      }
+    }
+
+    if (holes != sizeof...(Args)) {
+      detail::format_string_error("the format string has fewer placeholders than arguments");
+    }
+  }
+
+  constexpr std::string_view view() const {
+    return m_str;
+  }
+
+  // The offset of the placeholder for the argument at `index`
+  constexpr std::size_t hole(std::size_t index) const {
+    return m_holes[index];
+  }
+
+  // Whether the literal text contains escaped braces
+  constexpr bool has_escapes() const {
+    return m_escapes;
+  }
+};
+
+namespace detail {
+
+template <IsStringBuffer B> void format_literal_to(B& buf, std::string_view text, bool escapes) {
+  if (!escapes) {
+    buf.append(text.data(), text.size());
+    return;
+  }
+
+  // The format string has been validated, so every brace in literal text is doubled
+  std::size_t start = 0;
+  for (std::size_t brace = text.find_first_of("{}"); brace != std::string_view::npos;
+       brace             = text.find_first_of("{}", start)) {
+    buf.append(text.data() + start, brace + 1 - start);
+    start = brace + 2;
+  }
+  buf.append(text.data() + start, text.size() - start);
+}
+
+// Append the literal text from `cursor` up to the next placeholder,
+// returning the offset just past that placeholder (or npos, if there are none left)
+template <IsStringBuffer B> std::size_t format_literal_until_hole(B& buf, std::string_view text, std::size_t cursor) {
+  while (true) {
+    std::size_t brace = text.find_first_of("{}", cursor);
+    if (brace == std::string_view::npos) {
+      buf.append(text.data() + cursor, text.size() - cursor);
+      return std::string_view::npos;
+    }
+
+    buf.append(text.data() + cursor, brace - cursor);
+    if (text[brace] == '{' && text[brace + 1] == '}') {
+      return brace + 2;
+    }
+    buf.push_back(text[brace]);
+    cursor = brace + 2;
+  }
+}
+
+//
+// Format a string which was checked (as a FormatString) at compile time, but of
+// which only the text was kept. Placeholders are located as the string is scanned
+//
+template <IsStringBuffer B, typename... Args> void format_unchecked_to(B& buf, std::string_view fmt, Args const&... args) {
+  std::size_t cursor = 0;
+  ((cursor = format_literal_until_hole(buf, fmt, cursor), stringify_to(buf, args)), ...);
+  format_literal_until_hole(buf, fmt, cursor);
+}
+
+}; // namespace detail
+
+//
+// Append the format string onto `buf`, with each placeholder
+// replaced by the stringified form of its argument
+//
+// Arguments are appended directly through `stringify_to`, so no
+// intermediate strings are built for numbers, strings, enums or containers
+//
+template <IsStringBuffer B, typename... Args>
+  requires(IsStringifiable<Args> && ...)
+void format_to(B& buf, FormatString<std::type_identity_t<Args>...> fmt, Args const&... args) {
+  std::string_view str    = fmt.view();
+  std::size_t      cursor = 0;
+  [[maybe_unused]] std::size_t index = 0;
+
+  (
+      [&](auto const& arg) {
+        std::size_t hole = fmt.hole(index++);
+        detail::format_literal_to(buf, str.substr(cursor, hole - cursor), fmt.has_escapes());
+        stringify_to(buf, arg);
+        cursor = hole + 2;
+      }(args),
+      ...);
+
+  detail::format_literal_to(buf, str.substr(cursor), fmt.has_escapes());
+}
+
+//
+// Format into a new string (see `format_to`)
+//
+template <typename... Args>
+  requires(IsStringifiable<Args> && ...)
+std::string format(FormatString<std::type_identity_t<Args>...> fmt, Args const&... args) {
+  std::string ret;
+  format_to(ret, fmt, args...);
+  return ret;
+}
+
+}; // namespace mutils
@@ -0,0 +1,192 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+//
+// interner.h
+//
+// A thread-safe string interning pool
+//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace mutils::string {
+
+//
+// A handle to an interned string
+//
+// Two symbols from the same Interner are equal if and only if their strings are,
+// so equality and hashing are plain integer operations
+//
+struct Symbol {
+  uint32_t id;
+
+  friend auto operator<=>(Symbol, Symbol) = default;
+};
+
+//
+// Stores a single copy of each unique string, identified by a stable 32-bit Symbol
+//
+// - strings are copied into an append-only arena, so resolved views remain
+//   valid for the lifetime of the Interner
+// - lookups (`find`, `resolve`, and `intern` of an existing string) take no locks
+// - insertions are sharded by hash, so producers on different threads rarely contend
+//
+class Interner {
+public:
+  static constexpr std::size_t SHARD_COUNT = 16;
+
+  Interner();
+  ~Interner();
+
+  Interner(Interner const&)            = delete;
+  Interner& operator=(Interner const&) = delete;
+
+  /**
+   * Get the symbol for a string, interning it if it has not been seen before
+   */
+  Symbol intern(std::string_view s) {
+    uint64_t h = hash(s);
+    if (auto sym = m_find(s, h)) {
+      return *sym;
+    }
+    return m_insert(s, h);
+  }
+
+  /**
+   * Get the symbol for a string, if it has previously been interned
+   */
+  std::optional<Symbol> find(std::string_view s) const {
+    return m_find(s, hash(s));
+  }
+
+  /**
+   * Get the string represented by a symbol
+   */
+  std::string_view resolve(Symbol sym) const {
+    auto loc = m_locate(sym.id);
+    return m_segments[loc.segment].load(std::memory_order_acquire)[loc.offset];
+  }
+
+  /**
+   * The number of unique strings which have been interned
+   */
+  std::size_t size() const {
+    return m_next_id.load(std::memory_order_acquire);
+  }
+
+private:
+  //
+  // Symbols index into a segmented table, where segment k holds
+  // 2^(FIRST_SEGMENT_BITS + k) entries. Segments are never moved,
+  // so readers can index them while new segments are added
+  //
+  static constexpr std::size_t FIRST_SEGMENT_BITS = 10;
+  static constexpr std::size_t SEGMENT_COUNT      = 32 - FIRST_SEGMENT_BITS + 1;
+
+  struct SegmentLocation {
+    std::size_t segment;
+    std::size_t offset;
+  };
+
+  static SegmentLocation m_locate(uint32_t id) {
+    uint64_t    biased  = uint64_t(id) + (uint64_t(1) << FIRST_SEGMENT_BITS);
+    std::size_t top_bit = 63 - __builtin_clzll(biased);
+    return {top_bit - FIRST_SEGMENT_BITS, std::size_t(biased - (uint64_t(1) << top_bit))};
+  }
+
+  //
+  // Each shard owns an open-addressing table of (hash tag, symbol) slots.
+  // A slot packs the upper 32 bits of the hash with the symbol id + 1,
+  // 0 marks an empty slot. Slots are only ever written under the shard's lock,
+  // and are published with release stores, so readers need no lock
+  //
+  struct Table {
+    std::size_t                              mask;
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+  };
+
+  struct alignas(64) Shard {
+    std::atomic<Table*>                  table{nullptr};
+    std::mutex                           lock;
+    std::size_t                          count = 0;
+    std::vector<std::unique_ptr<Table>>  tables; // retired tables are kept alive for concurrent readers
+    std::vector<std::unique_ptr<char[]>> arena;
+    std::size_t                          arena_used     = 0;
+    std::size_t                          arena_capacity = 0;
+  };
+
+  static uint64_t hash(std::string_view s) {
+    return std::hash<std::string_view>{}(s) * 0x9E3779B97F4A7C15ull;
+  }
+
+  static Shard const& m_shard_for(Shard const* shards, uint64_t h) {
+    return shards[h >> 60];
+  }
+
+  std::optional<Symbol> m_find(std::string_view s, uint64_t h) const {
+    Table const* table = m_shard_for(m_shards, h).table.load(std::memory_order_acquire);
+    uint32_t     tag   = uint32_t(h >> 32);
+
+    for (std::size_t i = h & table->mask;; i = (i + 1) & table->mask) {
+      uint64_t slot = table->slots[i].load(std::memory_order_acquire);
+      if (slot == 0) {
+        return std::nullopt;
+      }
+      if (uint32_t(slot >> 32) == tag) {
+        Symbol sym{uint32_t(slot) - 1};
+        if (resolve(sym) == s) {
+          return sym;
+        }
+      }
+    }
+  }
+
+  Symbol m_insert(std::string_view s, uint64_t h);
+
+  static std::unique_ptr<Table> m_make_table(std::size_t slot_count);
+
+  // Place a slot into a table, the caller must hold the shard's lock
+  static void m_place_slot(Table& table, uint64_t h, uint64_t slot);
+
+  Shard                                                     m_shards[SHARD_COUNT];
+  std::array<std::atomic<std::string_view*>, SEGMENT_COUNT> m_segments;
+  std::atomic<uint32_t>                                     m_next_id{0};
+};
+
+}; // namespace mutils::string
+
+template <> struct std::hash<mutils::string::Symbol> {
+  std::size_t operator()(mutils::string::Symbol sym) const noexcept {
+    return std::hash<uint32_t>{}(sym.id);
+  }
+};
@@ -21,7 +21,9 @@
 
 #pragma once
 
+#include "../format.h"
 #include<string>
+#include<string_view>
 
 namespace mutils{
 
@@ -42,10 +44,19 @@ struct LogMessageContent{
 //
 struct PlaintextLogMessageContent : LogMessageContent{
 
+  // The format string the message was built from (a view, it is never copied)
+  std::string_view format_string;
 
+  //
+  // Format the message from a `{}` format string (see format.h),
+  // the placeholders are checked against the arguments at compile time
+  //
   template<typename... TemplateTypes>
-  PlaintextLogMessageContent(std::string, TemplateTypes... formatting){
-    // TODO: Implement templating
+    requires(sizeof...(TemplateTypes) > 0)
+  PlaintextLogMessageContent(FormatString<std::type_identity_t<TemplateTypes>...> format,
+                             TemplateTypes const&... formatting)
+      : format_string(format.view()) {
+    format_to(log_message_encoded_as_str, format, formatting...);
   }
 
   PlaintextLogMessageContent(std::string content){
@@ -1,15 +1,15 @@
 /// Copyright (c) 2023 Samir Bioud
-/// 
+///
 /// Permission is hereby granted, free of charge, to any person obtaining a copy
 /// of this software and associated documentation files (the "Software"), to deal
 /// in the Software without restriction, including without limitation the rights
 /// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
 /// copies of the Software, and to permit persons to whom the Software is
 /// furnished to do so, subject to the following conditions:
-/// 
+///
 /// The above copyright notice and this permission notice shall be included in all
 /// copies or substantial portions of the Software.
-/// 
+///
 /// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
 /// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
 /// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
@@ -17,18 +17,90 @@
 /// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
 /// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
 /// OR OTHER DEALINGS IN THE SOFTWARE.
-/// 
+///
 
 
 
+//
+// panic.h
+//
+// Fatal error reporting, safe to use from signal handlers
+//
+
 #pragma once
 
-#include <iostream>
-#include<string>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
 namespace mutils {
-[[noreturn]] __attribute__((always_inline)) inline void PANIC(std::string msg) {
-  std::string panic = "\033[0;31;1mpanic:  \033[0;0m";
-  std::cerr << panic << msg << std::endl;
-  abort();
-}
+
+//
+// Print a message (and a backtrace) to stderr, run the panic hooks, then abort
+//
+// Pending stdout (and std::cout) output is flushed first. Past that, the panic path
+// is async-signal-safe: the report is formatted into a static buffer and written
+// with write(2), nothing is allocated and no locks are taken.
+// If several threads panic at once, only the first reports (the others block until the process ends)
+//
+[[noreturn]] void PANIC(std::string_view msg);
+
+//
+// Called while panicking, before the process aborts (i.e to flush buffered logs)
+//
+// Hooks may run within a signal handler, so should restrict themselves to
+// async-signal-safe functions. A hook which panics aborts the process immediately
+//
+using PanicHook = void (*)();
+
+inline constexpr std::size_t MAX_PANIC_HOOKS = 16;
+
+/**
+ * Register a hook to run on panic (in order of registration), returns false once MAX_PANIC_HOOKS are registered
+ */
+bool add_panic_hook(PanicHook hook);
+
+/**
+ * Route SIGSEGV and SIGBUS through the panic path, and install an alternate signal stack for the calling thread
+ *
+ * Alternate stacks are per thread, other threads must call `install_crash_stack` for their own stack
+ * overflows to be reported (without one, the handler cannot run and the process dies silently)
+ */
+void install_crash_handlers();
+
+/**
+ * Install an alternate signal stack for the calling thread (freed when the thread exits),
+ * does nothing if the thread already has one
+ */
+void install_crash_stack();
+
+//
+// The return addresses of the calling thread's stack
+//
+// Capturing only walks the stack, symbol names are looked up when (if ever) `symbolize` is called
+//
+class Backtrace {
+public:
+  static constexpr std::size_t MAX_FRAMES = 64;
+
+  /**
+   * Capture the calling thread's stack, omitting the innermost `skip` frames (besides `capture` itself)
+   */
+  static Backtrace capture(std::size_t skip = 0);
+
+  std::span<void* const> frames() const {
+    return {m_frames, m_size};
+  }
+
+  /**
+   * Describe each frame, as `module(symbol+offset) [address]` (this allocates, so is not async-signal-safe)
+   */
+  std::vector<std::string> symbolize() const;
+
+private:
+  void*       m_frames[MAX_FRAMES];
+  std::size_t m_size = 0;
+};
+
 }; // namespace mutils
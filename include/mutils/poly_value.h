@@ -0,0 +1,257 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace mutils {
+
+/**
+ * A polymorphic value type
+ *
+ * Holds a single object of any class derived from `Base`, with value semantics.
+ * Objects of up to `InlineBytes` bytes (which are nothrow movable, and not
+ * over-aligned) are stored inline, larger objects fall back to the heap
+ *
+ * Copies and moves are performed through a small per-type table of functions,
+ * accessing the held object is a plain pointer dereference
+ *
+ * A `Copyable` PolyValue only accepts copy constructible types, to hold
+ * move-only types use a `UniquePolyValue`, which cannot itself be copied
+ */
+template <class Base, std::size_t InlineBytes = 64, bool Copyable = true> class PolyValue {
+  template <typename T>
+  static constexpr bool fits_inline = sizeof(T) <= InlineBytes && alignof(T) <= alignof(std::max_align_t) &&
+                                      std::is_nothrow_move_constructible_v<T>;
+
+  struct VTable {
+    // Copy-construct the object into `dst` (or onto the heap), returning the new object (null if not `Copyable`)
+    Base* (*copy)(void* dst, Base const* src);
+
+    // Move the inline object from `src` into `dst`, destroying the source
+    Base* (*relocate)(void* dst, Base* src) noexcept;
+
+    void (*destroy)(Base* obj) noexcept;
+
+    bool is_inline;
+  };
+
+  template <typename T> static Base* copy_impl(void* dst, Base const* src) {
+    T const& obj = *static_cast<T const*>(src);
+    if constexpr (fits_inline<T>) {
+      return ::new (dst) T(obj);
+    } else {
+      return new T(obj);
+    }
+  }
+
+  // Only instantiated for copyable PolyValues, which reject non-copyable types up-front
+  template <typename T> static constexpr auto copy_for() -> Base* (*)(void*, Base const*) {
+    if constexpr (Copyable) {
+      return copy_impl<T>;
+    } else {
+      return nullptr;
+    }
+  }
+
+  template <typename T>
+  static constexpr VTable vtable_for{
+      copy_for<T>(),
+      [](void* dst, Base* src) noexcept -> Base* {
+        if constexpr (fits_inline<T>) {
+          T*    obj = static_cast<T*>(src);
+          Base* ret = ::new (dst) T(std::move(*obj));
+          obj->~T();
+          return ret;
+        } else {
+          // Heap objects are never relocated, ownership of the pointer is transferred instead
+          return src;
+        }
+      },
+      [](Base* obj) noexcept {
+        if constexpr (fits_inline<T>) {
+          static_cast<T*>(obj)->~T();
+        } else {
+          delete static_cast<T*>(obj);
+        }
+      },
+      fits_inline<T>,
+  };
+
+  alignas(std::max_align_t) std::byte m_storage[InlineBytes];
+
+  Base*         m_ptr    = nullptr;
+  VTable const* m_vtable = nullptr;
+
+public:
+  static constexpr std::size_t inline_capacity = InlineBytes;
+
+  /**
+   * Construct an empty PolyValue
+   */
+  PolyValue() = default;
+
+  /**
+   * Construct a PolyValue holding a T, built from the given arguments
+   */
+  template <typename T, typename... Args>
+  explicit PolyValue(std::in_place_type_t<T>, Args&&... args) {
+    emplace<T>(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Construct a PolyValue holding a copy of (or moving from) `value`
+   */
+  template <typename T>
+    requires std::is_base_of_v<Base, std::remove_cvref_t<T>> &&
+             (!std::is_same_v<std::remove_cvref_t<T>, PolyValue>)
+  PolyValue(T&& value) {
+    emplace<std::remove_cvref_t<T>>(std::forward<T>(value));
+  }
+
+  PolyValue(PolyValue const& other)
+    requires Copyable
+  {
+    if (other.m_vtable) {
+      m_ptr    = other.m_vtable->copy(m_storage, other.m_ptr);
+      m_vtable = other.m_vtable;
+    }
+  }
+
+  PolyValue(PolyValue&& other) noexcept {
+    m_steal(other);
+  }
+
+  PolyValue& operator=(PolyValue const& other)
+    requires Copyable
+  {
+    if (this != &other) {
+      PolyValue tmp(other);
+      reset();
+      m_steal(tmp);
+    }
+    return *this;
+  }
+
+  PolyValue& operator=(PolyValue&& other) noexcept {
+    if (this != &other) {
+      reset();
+      m_steal(other);
+    }
+    return *this;
+  }
+
+  ~PolyValue() {
+    reset();
+  }
+
+  /**
+   * Replace the held object with a T, built from the given arguments
+   */
+  template <typename T, typename... Args> T& emplace(Args&&... args) {
+    static_assert(std::is_base_of_v<Base, T>, "A PolyValue can only hold types which inherit from the Base Class");
+    static_assert(!Copyable || std::is_copy_constructible_v<T>,
+                  "A copyable PolyValue cannot hold a non-copyable type, use a UniquePolyValue instead");
+    reset();
+
+    T* obj;
+    if constexpr (fits_inline<T>) {
+      obj = ::new (static_cast<void*>(m_storage)) T(std::forward<Args>(args)...);
+    } else {
+      obj = new T(std::forward<Args>(args)...);
+    }
+    m_ptr    = obj;
+    m_vtable = &vtable_for<T>;
+    return *obj;
+  }
+
+  /**
+   * Destroy the held object, leaving the PolyValue empty
+   */
+  void reset() noexcept {
+    if (m_vtable) {
+      m_vtable->destroy(m_ptr);
+      m_ptr    = nullptr;
+      m_vtable = nullptr;
+    }
+  }
+
+  bool has_value() const {
+    return m_ptr != nullptr;
+  }
+
+  explicit operator bool() const {
+    return has_value();
+  }
+
+  /**
+   * Whether the held object lives within the PolyValue itself (as opposed to the heap)
+   */
+  bool is_inline() const {
+    return m_vtable && m_vtable->is_inline;
+  }
+
+  Base* get() {
+    return m_ptr;
+  }
+
+  Base const* get() const {
+    return m_ptr;
+  }
+
+  Base& operator*() {
+    return *m_ptr;
+  }
+
+  Base const& operator*() const {
+    return *m_ptr;
+  }
+
+  Base* operator->() {
+    return m_ptr;
+  }
+
+  Base const* operator->() const {
+    return m_ptr;
+  }
+
+private:
+  void m_steal(PolyValue& other) noexcept {
+    if (!other.m_vtable) {
+      return;
+    }
+    m_ptr          = other.m_vtable->relocate(m_storage, other.m_ptr);
+    m_vtable       = other.m_vtable;
+    other.m_ptr    = nullptr;
+    other.m_vtable = nullptr;
+  }
+};
+
+/**
+ * A move-only PolyValue, which can hold types that cannot be copied
+ */
+template <class Base, std::size_t InlineBytes = 64> using UniquePolyValue = PolyValue<Base, InlineBytes, false>;
+
+}; // namespace mutils
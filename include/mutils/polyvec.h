@@ -21,73 +21,180 @@
 
 #pragma once
 
+#include "./poly_value.h"
+#include "./panic.h"
+#include<algorithm>
+#include<atomic>
+#include<cstddef>
+#include<cstdint>
+#include<cstring>
+#include<exception>
+#include<iterator>
 #include<memory>
+#include<mutex>
+#include<memory_resource>
+#include<new>
+#include<span>
+#include<system_error>
+#include<thread>
+#include<tuple>
+#include<type_traits>
+#include<utility>
 #include<vector>
 namespace mutils{
 
+namespace detail{
 
-/**
- * A Vector-Like class which supports polymorphic types
- * A PolyVec takes ownership of its contained items
-*/
-template<class _Items>
-class PolyVec{
-    std::vector<std::unique_ptr<_Items>> m_data;
-public:
+// The assumed size of a cache line, used to keep parallel chunks from sharing lines
+inline constexpr std::size_t POLYVEC_CACHE_LINE = 64;
 
-    struct Iterator{
-        using iterator_category = std::random_access_iterator_tag;
-        using difference_type   = std::ptrdiff_t;
-        using value_type        = _Items&;
-        using pointer           = std::unique_ptr<_Items>*;
-        using refefence         = std::unique_ptr<_Items>&;
+//
+// Invoke `fn(idx)` for every index in [0, count) across a set of worker threads
+//
+// Work is handed out in chunks via a shared atomic cursor, each chunk spanning a
+// whole number of cache lines of `slot_size`-byte slots. The calling thread
+// participates as one of the workers (if fewer threads can be started, those
+// which were share the work). The first exception thrown by `fn` is
+// rethrown once all workers have stopped
+//
+template<typename Fn>
+void parallel_for_index(std::size_t count, std::size_t slot_size, unsigned thread_count, Fn&& fn){
+    if(count == 0) return;
 
-        value_type operator*() const { return **m_ptr; }
-        pointer operator->() { return m_ptr; }
+    if(thread_count == 0){
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
 
-        Iterator(pointer ptr) : m_ptr(ptr){};
+    std::size_t per_line = std::max<std::size_t>(1, POLYVEC_CACHE_LINE / slot_size);
 
-        Iterator& operator++(){ m_ptr++; return *this; } 
-        Iterator operator++(int) { 
-            Iterator tmp = *this;
-            ++(*this);
-            return tmp; 
-        }
+    // Aim for a few chunks per thread so uneven work balances out
+    std::size_t chunk = count / (std::size_t(thread_count) * 4);
+    chunk = std::max(per_line, (chunk + per_line - 1) / per_line * per_line);
 
+    std::size_t chunk_count = (count + chunk - 1) / chunk;
+    if(chunk_count < thread_count){
+        thread_count = unsigned(chunk_count);
+    }
 
-        friend bool operator== (const Iterator& a, const Iterator& b) { return a.m_ptr == b.m_ptr; };
-        friend bool operator!= (const Iterator& a, const Iterator& b) { return a.m_ptr != b.m_ptr; }; 
+    std::atomic<std::size_t> next_chunk{0};
+    std::atomic<bool>        failed{false};
+    std::exception_ptr       error;
+    std::mutex               error_lock;
 
-    private:
-        pointer m_ptr;
+    auto worker = [&](){
+        try{
+            while(!failed.load(std::memory_order_relaxed)){
+                std::size_t c = next_chunk.fetch_add(1, std::memory_order_relaxed);
+                if(c >= chunk_count) break;
+
+                std::size_t start = c * chunk;
+                std::size_t stop  = std::min(count, start + chunk);
+                for(std::size_t i = start; i < stop; i++){
+                    fn(i);
+                }
+            }
+        }
+        catch(...){
+            std::lock_guard guard(error_lock);
+            if(!error) error = std::current_exception();
+            failed.store(true, std::memory_order_relaxed);
+        }
     };
 
-    struct ConstIterator{
-        using iterator_category = std::random_access_iterator_tag;
-        using difference_type   = std::ptrdiff_t;
-        using value_type        = _Items&;
-        using pointer           = std::unique_ptr<_Items> const*;
-        using refefence         = std::unique_ptr<_Items>&;
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for(unsigned i = 1; i < thread_count; i++){
+        try{
+            threads.emplace_back(worker);
+        }
+        catch(std::system_error const&){
+            // Chunks are claimed from the shared cursor, so the threads
+            // which did start (and this one) pick up the remaining work
+            break;
+        }
+    }
+    worker();
+    for(auto& t : threads) t.join();
 
-        value_type operator*() const { return **m_ptr; }
-        const pointer operator->() const { return m_ptr; }
+    if(error) std::rethrow_exception(error);
+}
 
-        ConstIterator(pointer ptr) : m_ptr(ptr){};
+//
+// A random-access iterator over an array of owning slots
+// (i.e std::unique_ptr<_Items>, _Items* or PolyValue<_Items>), yielding references to the items
+//
+template<class _Items, class _Slot, bool _Const>
+struct PolyVecIterator{
+    using iterator_category = std::random_access_iterator_tag;
+    using iterator_concept  = std::random_access_iterator_tag;
+    using difference_type   = std::ptrdiff_t;
+    using value_type        = _Items;
+    using reference         = std::conditional_t<_Const, _Items const&, _Items&>;
+    using pointer           = std::conditional_t<_Const, _Items const*, _Items*>;
+    using slot_pointer      = std::conditional_t<_Const, _Slot const*, _Slot*>;
 
-        ConstIterator& operator++(){ m_ptr++; return *this; } 
-        ConstIterator operator++(int) { 
-            ConstIterator tmp = *this;
-            ++(*this);
-            return tmp; 
-        }
+    PolyVecIterator() = default;
+    PolyVecIterator(slot_pointer ptr) : m_ptr(ptr){};
 
+    // Allow Iterator -> ConstIterator conversions
+    template<bool _OtherConst>
+        requires (_Const && !_OtherConst)
+    PolyVecIterator(PolyVecIterator<_Items, _Slot, _OtherConst> const& other) : m_ptr(other.slot()){};
 
-        friend bool operator== (const ConstIterator& a, const ConstIterator& b) { return a.m_ptr == b.m_ptr; };
-        friend bool operator!= (const ConstIterator& a, const ConstIterator& b) { return a.m_ptr != b.m_ptr; }; 
+    reference operator*() const { return **m_ptr; }
+    pointer operator->() const { return &**m_ptr; }
+    reference operator[](difference_type n) const { return *m_ptr[n]; }
 
-    private:
-        pointer m_ptr;
-    };
+    // The underlying slot
+    slot_pointer slot() const { return m_ptr; }
+
+    PolyVecIterator& operator++(){ m_ptr++; return *this; } 
+    PolyVecIterator& operator--(){ m_ptr--; return *this; } 
+    PolyVecIterator operator++(int) { 
+        PolyVecIterator tmp = *this;
+        ++(*this);
+        return tmp; 
+    }
+    PolyVecIterator operator--(int) { 
+        PolyVecIterator tmp = *this;
+        --(*this);
+        return tmp; 
+    }
+
+    PolyVecIterator& operator+=(difference_type n){ m_ptr += n; return *this; }
+    PolyVecIterator& operator-=(difference_type n){ m_ptr -= n; return *this; }
+
+    friend PolyVecIterator operator+(PolyVecIterator it, difference_type n){ return it += n; }
+    friend PolyVecIterator operator+(difference_type n, PolyVecIterator it){ return it += n; }
+    friend PolyVecIterator operator-(PolyVecIterator it, difference_type n){ return it -= n; }
+    friend difference_type operator-(PolyVecIterator const& a, PolyVecIterator const& b){ return a.m_ptr - b.m_ptr; }
+
+    friend bool operator== (const PolyVecIterator& a, const PolyVecIterator& b) { return a.m_ptr == b.m_ptr; };
+    friend auto operator<=> (const PolyVecIterator& a, const PolyVecIterator& b) { return a.m_ptr <=> b.m_ptr; };
+
+private:
+    slot_pointer m_ptr = nullptr;
+};
+
+}; // namespace detail
+
+
+/**
+ * A Vector-Like class which supports polymorphic types
+ * A PolyVec takes ownership of its contained items
+*/
+template<class _Items>
+class PolyVec{
+    std::vector<std::unique_ptr<_Items>> m_data;
+public:
+
+    template<bool _Const>
+    using BasicIterator = detail::PolyVecIterator<_Items, std::unique_ptr<_Items>, _Const>;
+
+    using Iterator             = BasicIterator<false>;
+    using ConstIterator        = BasicIterator<true>;
+    using ReverseIterator      = std::reverse_iterator<Iterator>;
+    using ConstReverseIterator = std::reverse_iterator<ConstIterator>;
 
     PolyVec() = default;
     PolyVec(size_t reserve_count) : m_data(reserve_count){}
@@ -147,30 +254,822 @@ public:
     }
 
 
+    /**
+     * Call `fn(_Items&)` on every item, distributing the work across multiple threads
+     *
+     * The items are split into chunks which are a multiple of a cache line's worth
+     * of slots, so no two threads contend over the same line of the slot array.
+     * `fn` must be safe to call concurrently on distinct items
+     *
+     * If `thread_count` is 0, std::thread::hardware_concurrency() is used
+    */
+    template<typename Fn>
+    void parallel_for_each(Fn&& fn, unsigned thread_count = 0){
+        auto* data = m_data.data();
+        detail::parallel_for_index(size(), sizeof(*data), thread_count, [&](std::size_t idx){
+            fn(*data[idx]);
+        });
+    }
+
     Iterator begin(){
-        return &*m_data.begin();
+        return m_data.data();
     }
     Iterator end(){
-        return &*m_data.end();
+        return m_data.data() + m_data.size();
     }
 
-    Iterator rbegin(){
-        return &*m_data.rbegin();
+    ReverseIterator rbegin(){
+        return ReverseIterator(end());
     }
-    Iterator rend(){
-        return &*m_data.rend();
+    ReverseIterator rend(){
+        return ReverseIterator(begin());
     }
 
     Iterator back(){
-        return &*m_data.back();
+        return end() - 1;
     }
 
     ConstIterator begin() const{
-        return &*m_data.cbegin();
+        return m_data.data();
     }
     ConstIterator end() const{
-        return &*m_data.cend();
+        return m_data.data() + m_data.size();
+    }
+
+    ConstReverseIterator rbegin() const{
+        return ConstReverseIterator(end());
+    }
+    ConstReverseIterator rend() const{
+        return ConstReverseIterator(begin());
+    }
+
+};
+
+
+/**
+ * A PolyVec which stores its items inline within a single contiguous,
+ * growable byte buffer instead of allocating each item separately
+ *
+ * Items are laid out back-to-back (respecting their alignment) in insertion
+ * order, and an offset table provides random access. When the buffer grows,
+ * every item is relocated into the new buffer (by memcpy if it is trivially
+ * copyable, otherwise by move-construct + destroy)
+ *
+ * Item types must be nothrow move constructible, as they are relocated on growth
+ *
+ * **NOTE**: References into an InlinePolyVec are invalidated whenever it grows
+*/
+template<class _Items>
+class InlinePolyVec{
+
+    // Type-erased operations required to manage an item
+    struct ItemOps{
+        void (*relocate)(void* dst, void* src) noexcept;
+        void (*destroy)(void* obj) noexcept;
+        bool trivial;
+    };
+
+    template<typename T>
+    static constexpr ItemOps ops_for{
+        [](void* dst, void* src) noexcept {
+            T* from = static_cast<T*>(src);
+            ::new (dst) T(std::move(*from));
+            from->~T();
+        },
+        [](void* obj) noexcept { static_cast<T*>(obj)->~T(); },
+        std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>,
+    };
+
+    struct Entry{
+        std::size_t     offset;      // Byte offset of the item within the buffer
+        std::ptrdiff_t  base_adjust; // Offset of the _Items subobject within the item
+        ItemOps const*  ops;
+    };
+
+    std::byte*          m_buffer    = nullptr;
+    std::size_t         m_used      = 0;
+    std::size_t         m_capacity  = 0;
+    std::size_t         m_alignment = alignof(std::max_align_t);
+    bool                m_trivial   = true; // every stored item is trivially relocatable
+    std::vector<Entry>  m_entries;
+
+    _Items* m_item_at(Entry const& e) const{
+        return std::launder(reinterpret_cast<_Items*>(m_buffer + e.offset + e.base_adjust));
+    }
+
+    // Move every item into a fresh buffer of at least `bytes` bytes, aligned to `align`
+    void m_relocate(std::size_t bytes, std::size_t align){
+        std::byte* fresh = static_cast<std::byte*>(::operator new(bytes, std::align_val_t(align)));
+
+        if(m_trivial){
+            if(m_used != 0) std::memcpy(fresh, m_buffer, m_used);
+        }
+        else{
+            for(auto& e : m_entries){
+                e.ops->relocate(fresh + e.offset, m_buffer + e.offset);
+            }
+        }
+
+        m_free_buffer();
+        m_buffer    = fresh;
+        m_capacity  = bytes;
+        m_alignment = align;
+    }
+
+    void m_free_buffer(){
+        if(m_buffer){
+            ::operator delete(m_buffer, std::align_val_t(m_alignment));
+        }
+    }
+
+    void m_destroy_all(){
+        if(!m_trivial){
+            for(auto& e : m_entries){
+                e.ops->destroy(m_buffer + e.offset);
+            }
+        }
+        m_entries.clear();
+        m_used    = 0;
+        m_trivial = true;
+    }
+
+    // Reserve space for an item of the given size and alignment, returning its offset
+    std::size_t m_allocate(std::size_t size, std::size_t align){
+        std::size_t offset = (m_used + align - 1) & ~(align - 1);
+        std::size_t needed = offset + size;
+
+        if(needed > m_capacity || align > m_alignment){
+            std::size_t new_cap = m_capacity ? m_capacity : 64;
+            while(new_cap < needed) new_cap *= 2;
+            m_relocate(new_cap, align > m_alignment ? align : m_alignment);
+        }
+        m_used = needed;
+        return offset;
+    }
+
+public:
+
+    template<bool _Const>
+    struct BasicIterator{
+        using iterator_category = std::random_access_iterator_tag;
+        using iterator_concept  = std::random_access_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = _Items;
+        using reference         = std::conditional_t<_Const, _Items const&, _Items&>;
+        using pointer           = std::conditional_t<_Const, _Items const*, _Items*>;
+        using Owner             = std::conditional_t<_Const, InlinePolyVec const, InlinePolyVec>;
+
+        BasicIterator() = default;
+        BasicIterator(Owner* owner, std::size_t idx) : m_owner(owner), m_idx(idx){}
+
+        reference operator*() const { return (*m_owner)[m_idx]; }
+        pointer operator->() const { return &(*m_owner)[m_idx]; }
+        reference operator[](difference_type n) const { return (*m_owner)[m_idx + n]; }
+
+        BasicIterator& operator++(){ m_idx++; return *this; }
+        BasicIterator& operator--(){ m_idx--; return *this; }
+        BasicIterator operator++(int){ auto tmp = *this; m_idx++; return tmp; }
+        BasicIterator operator--(int){ auto tmp = *this; m_idx--; return tmp; }
+
+        BasicIterator& operator+=(difference_type n){ m_idx += n; return *this; }
+        BasicIterator& operator-=(difference_type n){ m_idx -= n; return *this; }
+
+        friend BasicIterator operator+(BasicIterator it, difference_type n){ return it += n; }
+        friend BasicIterator operator+(difference_type n, BasicIterator it){ return it += n; }
+        friend BasicIterator operator-(BasicIterator it, difference_type n){ return it -= n; }
+        friend difference_type operator-(BasicIterator const& a, BasicIterator const& b){
+            return difference_type(a.m_idx) - difference_type(b.m_idx);
+        }
+
+        friend bool operator==(BasicIterator const& a, BasicIterator const& b){ return a.m_idx == b.m_idx; }
+        friend auto operator<=>(BasicIterator const& a, BasicIterator const& b){ return a.m_idx <=> b.m_idx; }
+
+    private:
+        Owner*      m_owner = nullptr;
+        std::size_t m_idx   = 0;
+    };
+
+    using Iterator      = BasicIterator<false>;
+    using ConstIterator = BasicIterator<true>;
+
+    InlinePolyVec() = default;
+
+    /**
+     * Preallocate space for `item_count` items, totalling `byte_count` bytes
+    */
+    InlinePolyVec(std::size_t item_count, std::size_t byte_count){
+        reserve(item_count, byte_count);
+    }
+
+    InlinePolyVec(InlinePolyVec const&) = delete;
+    InlinePolyVec& operator=(InlinePolyVec const&) = delete;
+
+    InlinePolyVec(InlinePolyVec&& other) noexcept{
+        *this = std::move(other);
+    }
+
+    InlinePolyVec& operator=(InlinePolyVec&& other) noexcept{
+        if(this != &other){
+            m_destroy_all();
+            m_free_buffer();
+            m_buffer    = std::exchange(other.m_buffer, nullptr);
+            m_used      = std::exchange(other.m_used, 0);
+            m_capacity  = std::exchange(other.m_capacity, 0);
+            m_alignment = std::exchange(other.m_alignment, alignof(std::max_align_t));
+            m_trivial   = std::exchange(other.m_trivial, true);
+            m_entries   = std::move(other.m_entries);
+            other.m_entries.clear();
+        }
+        return *this;
+    }
+
+    ~InlinePolyVec(){
+        m_destroy_all();
+        m_free_buffer();
+    }
+
+    /**
+     * Construct an item of type T in-place at the end of the vector
+    */
+    template<typename T, typename... Args>
+    T& emplace(Args&&... args){
+        static_assert(std::is_base_of<_Items, T>::value, "You cannot push an item to a PolyVec which does not inherit from the Base Class");
+        static_assert(std::is_nothrow_move_constructible<T>::value, "Items of an InlinePolyVec must be nothrow move constructible");
+
+        // Make room for the entry first, so that recording it cannot throw once the item exists
+        if(m_entries.size() == m_entries.capacity()){
+            m_entries.reserve(std::max<std::size_t>(1, 2 * m_entries.capacity()));
+        }
+
+        std::size_t prev_used = m_used;
+        std::size_t offset    = m_allocate(sizeof(T), alignof(T));
+        T* item;
+        try{
+            item = ::new (m_buffer + offset) T(std::forward<Args>(args)...);
+        }
+        catch(...){
+            m_used = prev_used;
+            throw;
+        }
+
+        auto base_adjust = reinterpret_cast<std::byte*>(static_cast<_Items*>(item)) - reinterpret_cast<std::byte*>(item);
+        m_entries.push_back(Entry{offset, base_adjust, &ops_for<T>});
+        m_trivial = m_trivial && ops_for<T>.trivial;
+        return *item;
+    }
+
+    /**
+     * Move a class instance into the vector
+    */
+    template<typename T>
+    void push(T&& item){
+        emplace<std::remove_cvref_t<T>>(std::forward<T>(item));
+    }
+
+    /**
+     * Destroy the last item in the vector
+    */
+    void pop(){
+        Entry e = m_entries.back();
+        m_entries.pop_back();
+        e.ops->destroy(m_buffer + e.offset);
+        m_used = e.offset;
+    }
+
+    _Items& operator[](std::size_t idx){
+        return *m_item_at(m_entries[idx]);
+    }
+
+    _Items const& operator[](std::size_t idx) const{
+        return *m_item_at(m_entries[idx]);
+    }
+
+    _Items& back(){
+        return *m_item_at(m_entries.back());
+    }
+
+    std::size_t size() const{
+        return m_entries.size();
+    }
+
+    bool empty() const{
+        return m_entries.empty();
+    }
+
+    /**
+     * The number of bytes currently occupied by items (including padding)
+    */
+    std::size_t bytes_used() const{
+        return m_used;
+    }
+
+    /**
+     * The number of bytes the buffer can hold before it must grow
+    */
+    std::size_t byte_capacity() const{
+        return m_capacity;
+    }
+
+    void reserve(std::size_t item_count, std::size_t byte_count){
+        m_entries.reserve(item_count);
+        if(byte_count > m_capacity){
+            m_relocate(byte_count, m_alignment);
+        }
+    }
+
+    /**
+     * Destroy every item, the buffer is retained for reuse
+    */
+    void clear(){
+        m_destroy_all();
+    }
+
+    /**
+     * Call `fn(_Items&)` on every item, distributing the work across multiple threads
+     *
+     * See `PolyVec::parallel_for_each`
+    */
+    template<typename Fn>
+    void parallel_for_each(Fn&& fn, unsigned thread_count = 0){
+        detail::parallel_for_index(size(), sizeof(Entry), thread_count, [&](std::size_t idx){
+            fn(*m_item_at(m_entries[idx]));
+        });
+    }
+
+    Iterator begin(){ return Iterator(this, 0); }
+    Iterator end(){ return Iterator(this, size()); }
+    ConstIterator begin() const{ return ConstIterator(this, 0); }
+    ConstIterator end() const{ return ConstIterator(this, size()); }
+
+};
+
+
+/**
+ * A PolyVec which buckets its items by their concrete type
+ *
+ * Each of the `_Types` is stored in its own contiguous std::vector, so
+ * iterating a bucket touches memory linearly, and the callback is given the
+ * bucket's static type. The set of concrete types must be known up-front
+ *
+ * Virtual members called on that reference still dispatch, unless the bucket
+ * type (or the member) is `final`, which lets the compiler devirtualize them
+ *
+ * Optionally, an insertion-order index can be kept so the items can also be
+ * visited in the order they were pushed
+*/
+template<class _Items, class... _Types>
+class SegregatedPolyVec{
+    static_assert((std::is_base_of<_Items, _Types>::value && ...), "Every bucket type of a SegregatedPolyVec must inherit from the Base Class");
+
+    template<typename T>
+    static constexpr std::size_t index_of(){
+        constexpr bool matches[] = {std::is_same_v<T, _Types>...};
+        for(std::size_t i = 0; i < sizeof...(_Types); i++){
+            if(matches[i]) return i;
+        }
+        return sizeof...(_Types);
+    }
+
+    template<typename T>
+    static constexpr void assert_bucket(){
+        static_assert(index_of<T>() < sizeof...(_Types), "The type is not one of the bucket types of this SegregatedPolyVec");
+    }
+
+    struct OrderEntry{
+        std::uint32_t bucket;
+        std::uint32_t idx;
+    };
+
+    std::tuple<std::vector<_Types>...> m_buckets;
+    std::vector<OrderEntry>            m_order;
+    bool                               m_track_order;
+
+    template<std::size_t... Is, typename Fn>
+    void m_dispatch(OrderEntry e, Fn& fn, std::index_sequence<Is...>){
+        (void)((e.bucket == Is ? (fn(std::get<Is>(m_buckets)[e.idx]), true) : false) || ...);
+    }
+
+    void m_require_order(char const* operation) const{
+        if(!m_track_order){
+            PANIC(std::string("SegregatedPolyVec::") + operation + " requires insertion order tracking, which is disabled");
+        }
+    }
+
+public:
+
+    /**
+     * If `track_insertion_order` is set, the order in which the items were pushed
+     * is recorded, enabling `for_each_ordered` and indexing
+    */
+    SegregatedPolyVec(bool track_insertion_order = false) : m_track_order(track_insertion_order){}
+
+    /**
+     * Construct an item of type T in-place at the end of its bucket
+    */
+    template<typename T, typename... Args>
+    T& emplace(Args&&... args){
+        assert_bucket<T>();
+        auto& bucket = std::get<index_of<T>()>(m_buckets);
+        T& item = bucket.emplace_back(std::forward<Args>(args)...);
+        if(m_track_order){
+            m_order.push_back(OrderEntry{std::uint32_t(index_of<T>()), std::uint32_t(bucket.size() - 1)});
+        }
+        return item;
+    }
+
+    /**
+     * Move a class instance into its bucket
+    */
+    template<typename T>
+    void push(T&& item){
+        emplace<std::remove_cvref_t<T>>(std::forward<T>(item));
+    }
+
+    /**
+     * Get the contiguous storage of every item of type T
+    */
+    template<typename T>
+    std::span<T> bucket(){
+        assert_bucket<T>();
+        return std::get<index_of<T>()>(m_buckets);
+    }
+
+    /**
+     * Call `fn(T&)` on every item of type T
+    */
+    template<typename T, typename Fn>
+    void for_each(Fn&& fn){
+        for(T& item : bucket<T>()){
+            fn(item);
+        }
+    }
+
+    /**
+     * Call `fn` on every item, bucket by bucket
+     *
+     * `fn` is invoked with the concrete type of each bucket, so it should
+     * be a generic callable (i.e `[](auto& item){ ... }`)
+    */
+    template<typename Fn>
+    void visit_all(Fn&& fn){
+        (for_each<_Types>(fn), ...);
+    }
+
+    /**
+     * Call `fn` on every item, in the order they were inserted
+     *
+     * Requires insertion order tracking to be enabled
+    */
+    template<typename Fn>
+    void for_each_ordered(Fn&& fn){
+        m_require_order("for_each_ordered()");
+        for(auto e : m_order){
+            m_dispatch(e, fn, std::index_sequence_for<_Types...>{});
+        }
+    }
+
+    /**
+     * Get the item at the given insertion index
+     *
+     * Requires insertion order tracking to be enabled
+    */
+    _Items& operator[](std::size_t idx){
+        _Items* ret = nullptr;
+        auto fn = [&](_Items& item){ ret = &item; };
+        m_require_order("operator[]");
+        m_dispatch(m_order[idx], fn, std::index_sequence_for<_Types...>{});
+        return *ret;
+    }
+
+    bool tracks_insertion_order() const{
+        return m_track_order;
+    }
+
+    std::size_t size() const{
+        return std::apply([](auto const&... b){ return (b.size() + ... + 0); }, m_buckets);
+    }
+
+    template<typename T>
+    std::size_t size() const{
+        assert_bucket<T>();
+        return std::get<index_of<T>()>(m_buckets).size();
+    }
+
+    bool empty() const{
+        return size() == 0;
+    }
+
+    template<typename T>
+    void reserve(std::size_t n){
+        assert_bucket<T>();
+        std::get<index_of<T>()>(m_buckets).reserve(n);
+    }
+
+    void clear(){
+        std::apply([](auto&... b){ (b.clear(), ...); }, m_buckets);
+        m_order.clear();
+    }
+};
+
+
+/**
+ * A PolyVec which stores its items as PolyValues
+ *
+ * Items of up to `InlineBytes` bytes are stored directly within the vector's
+ * own buffer, only larger items require a separate heap allocation
+ *
+ * Unless `Copyable` is unset, every item type must be copy constructible
+*/
+template<class _Items, std::size_t InlineBytes = 64, bool Copyable = true>
+class PolyValueVec{
+public:
+    using Value = PolyValue<_Items, InlineBytes, Copyable>;
+
+private:
+    std::vector<Value> m_data;
+
+public:
+
+    using Iterator             = detail::PolyVecIterator<_Items, Value, false>;
+    using ConstIterator        = detail::PolyVecIterator<_Items, Value, true>;
+    using ReverseIterator      = std::reverse_iterator<Iterator>;
+    using ConstReverseIterator = std::reverse_iterator<ConstIterator>;
+
+    PolyValueVec() = default;
+
+    /**
+     * Construct an item of type T in-place at the end of the vector
+    */
+    template<typename T, typename... Args>
+    T& emplace(Args&&... args){
+        static_assert(std::is_base_of<_Items, T>::value, "You cannot push an item to a PolyVec which does not inherit from the Base Class");
+        return m_data.emplace_back().template emplace<T>(std::forward<Args>(args)...);
+    }
+
+    /**
+     * Push a class instance (or an existing PolyValue) to the vector
+    */
+    template<typename T>
+    void push(T&& item){
+        m_data.emplace_back(std::forward<T>(item));
+    }
+
+    Value pop(){
+        Value item = std::move(m_data.back());
+        m_data.pop_back();
+        return item;
+    }
+
+    _Items& operator[](size_t idx){
+        return *m_data[idx];
+    }
+
+    _Items const& operator[](size_t idx) const{
+        return *m_data[idx];
+    }
+
+    size_t size() const{
+        return m_data.size();
+    }
+
+    size_t capacity() const{
+        return m_data.capacity();
+    }
+
+    void reserve(size_t n){
+        m_data.reserve(n);
+    }
+
+    void clear(){
+        m_data.clear();
+    }
+
+    bool empty() const{
+        return m_data.empty();
+    }
+
+    /**
+     * Call `fn(_Items&)` on every item, distributing the work across multiple threads
+     *
+     * See `PolyVec::parallel_for_each`
+    */
+    template<typename Fn>
+    void parallel_for_each(Fn&& fn, unsigned thread_count = 0){
+        auto* data = m_data.data();
+        detail::parallel_for_index(size(), sizeof(Value), thread_count, [&](std::size_t idx){
+            fn(*data[idx]);
+        });
+    }
+
+    Iterator begin(){ return m_data.data(); }
+    Iterator end(){ return m_data.data() + m_data.size(); }
+    ConstIterator begin() const{ return m_data.data(); }
+    ConstIterator end() const{ return m_data.data() + m_data.size(); }
+
+    ReverseIterator rbegin(){ return ReverseIterator(end()); }
+    ReverseIterator rend(){ return ReverseIterator(begin()); }
+    ConstReverseIterator rbegin() const{ return ConstReverseIterator(end()); }
+    ConstReverseIterator rend() const{ return ConstReverseIterator(begin()); }
+};
+
+namespace pmr{
+
+/**
+ * A PolyVec which allocates both its pointer array and its items
+ * from a std::pmr::memory_resource
+ *
+ * Pair this with a std::pmr::monotonic_buffer_resource (or any other arena)
+ * and `release_all()` (before releasing the arena) to drop every item without
+ * freeing them one at a time
+*/
+template<class _Items>
+class PolyVec{
+
+    // Type-erased operations required to tear down an item
+    struct ItemOps{
+        void (*destroy)(_Items* item) noexcept;
+        void (*destroy_and_free)(std::pmr::memory_resource* res, _Items* item) noexcept;
+    };
+
+    template<typename T>
+    static constexpr ItemOps ops_for{
+        [](_Items* item) noexcept { static_cast<T*>(item)->~T(); },
+        [](std::pmr::memory_resource* res, _Items* item) noexcept {
+            T* obj = static_cast<T*>(item);
+            obj->~T();
+            res->deallocate(obj, sizeof(T), alignof(T));
+        },
+    };
+
+    // The items and their ops are stored separately, so that
+    // iteration only has to stream through the item pointers
+    std::pmr::vector<_Items*>        m_data;
+    std::pmr::vector<ItemOps const*> m_ops;
+    bool                             m_trivial = true; // every stored item is trivially destructible
+
+public:
+
+    using Iterator             = detail::PolyVecIterator<_Items, _Items*, false>;
+    using ConstIterator        = detail::PolyVecIterator<_Items, _Items*, true>;
+    using ReverseIterator      = std::reverse_iterator<Iterator>;
+    using ConstReverseIterator = std::reverse_iterator<ConstIterator>;
+
+    PolyVec(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        m_data(resource), m_ops(resource){}
+
+    PolyVec(PolyVec const&) = delete;
+    PolyVec& operator=(PolyVec const&) = delete;
+
+    PolyVec(PolyVec&& other) noexcept :
+        m_data(std::move(other.m_data)), m_ops(std::move(other.m_ops)), m_trivial(other.m_trivial){
+        other.m_data.clear();
+        other.m_ops.clear();
+        other.m_trivial = true;
+    }
+
+    ~PolyVec(){
+        clear();
+    }
+
+    std::pmr::memory_resource* resource() const{
+        return m_data.get_allocator().resource();
+    }
+
+    /**
+     * Construct an item of type T in-place at the end of the vector,
+     * the item is allocated from the vector's memory resource
+    */
+    template<typename T, typename... Args>
+    T& emplace(Args&&... args){
+        static_assert(std::is_base_of<_Items, T>::value, "You cannot push an item to a PolyVec which does not inherit from the Base Class");
+
+        // Make room first, so a failed push_back cannot leak the item
+        // (growing geometrically, as memory given back to a monotonic resource is never reused)
+        if(m_data.size() == m_data.capacity()){
+            m_data.reserve(std::max<std::size_t>(1, 2 * m_data.capacity()));
+        }
+        if(m_ops.size() == m_ops.capacity()){
+            m_ops.reserve(std::max<std::size_t>(1, 2 * m_ops.capacity()));
+        }
+
+        auto* res = resource();
+        void* mem = res->allocate(sizeof(T), alignof(T));
+        T* item;
+        try{
+            item = ::new (mem) T(std::forward<Args>(args)...);
+        }
+        catch(...){
+            res->deallocate(mem, sizeof(T), alignof(T));
+            throw;
+        }
+
+        m_data.push_back(item);
+        m_ops.push_back(&ops_for<T>);
+        m_trivial = m_trivial && std::is_trivially_destructible_v<T>;
+        return *item;
     }
 
+    /**
+     * Move a class instance into the vector
+    */
+    template<typename T>
+    void push(T&& item){
+        emplace<std::remove_cvref_t<T>>(std::forward<T>(item));
+    }
+
+    /**
+     * Destroy and free the last item in the vector
+    */
+    void pop(){
+        m_ops.back()->destroy_and_free(resource(), m_data.back());
+        m_data.pop_back();
+        m_ops.pop_back();
+    }
+
+    _Items& operator[](size_t idx){
+        return *m_data[idx];
+    }
+
+    _Items const& operator[](size_t idx) const{
+        return *m_data[idx];
+    }
+
+    size_t size() const{
+        return m_data.size();
+    }
+
+    size_t capacity() const{
+        return m_data.capacity();
+    }
+
+    void reserve(size_t n){
+        m_data.reserve(n);
+        m_ops.reserve(n);
+    }
+
+    bool empty() const{
+        return m_data.empty();
+    }
+
+    /**
+     * Destroy every item, returning each one to the memory resource
+    */
+    void clear(){
+        auto* res = resource();
+        for(size_t i = 0; i < m_data.size(); i++){
+            m_ops[i]->destroy_and_free(res, m_data[i]);
+        }
+        m_data.clear();
+        m_ops.clear();
+        m_trivial = true;
+    }
+
+    /**
+     * Drop every item without returning their memory to the resource
+     *
+     * Destructors are only run if some item has a non-trivial destructor,
+     * and `run_destructors` is set. This is intended for arena-like resources,
+     * where the memory is reclaimed in bulk when the resource itself is released
+     *
+     * **WARNING**: With a resource that frees individually (i.e the default resource)
+     * the items' memory is leaked
+    */
+    void release_all(bool run_destructors = true){
+        if(run_destructors && !m_trivial){
+            for(size_t i = 0; i < m_data.size(); i++){
+                m_ops[i]->destroy(m_data[i]);
+            }
+        }
+        // The slot arrays came from the resource too, so are dropped along with
+        // the items, the resource can then be released and reused
+        m_data    = std::pmr::vector<_Items*>(resource());
+        m_ops     = std::pmr::vector<ItemOps const*>(m_data.get_allocator());
+        m_trivial = true;
+    }
+
+    /**
+     * Call `fn(_Items&)` on every item, distributing the work across multiple threads
+     *
+     * See `mutils::PolyVec::parallel_for_each`
+    */
+    template<typename Fn>
+    void parallel_for_each(Fn&& fn, unsigned thread_count = 0){
+        auto* data = m_data.data();
+        detail::parallel_for_index(size(), sizeof(*data), thread_count, [&](std::size_t idx){
+            fn(*data[idx]);
+        });
+    }
+
+    Iterator begin(){ return m_data.data(); }
+    Iterator end(){ return m_data.data() + m_data.size(); }
+    ConstIterator begin() const{ return m_data.data(); }
+    ConstIterator end() const{ return m_data.data() + m_data.size(); }
+
+    ReverseIterator rbegin(){ return ReverseIterator(end()); }
+    ReverseIterator rend(){ return ReverseIterator(begin()); }
+    ConstReverseIterator rbegin() const{ return ConstReverseIterator(end()); }
+    ConstReverseIterator rend() const{ return ConstReverseIterator(begin()); }
 };
+
+}; // namespace pmr
 };
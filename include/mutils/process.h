@@ -0,0 +1,207 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+
+//
+// process.h
+//
+// Spawning child processes through posix_spawn (POSIX only)
+//
+
+#pragma once
+
+#include "./env.h"
+#include "./result.h"
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+namespace mutils {
+
+//
+// Describes why a process could not be spawned, or communicated with
+//
+struct ProcessError {
+  enum Kind {
+    Spawn, // posix_spawn failed (i.e the program was not found)
+    Pipe,  // a pipe to the child could not be created
+    Read,  // the child's output could not be read
+    Wait,  // the child could not be waited for
+  } kind;
+
+  int error; // the errno value
+
+  std::string toString() const;
+};
+
+//
+// How a process exited, as reported by waitpid
+//
+struct ExitStatus {
+  int raw = 0;
+
+  /**
+   * Whether the process exited normally, with a status of 0
+   */
+  bool success() const;
+
+  /**
+   * The exit code, if the process exited normally
+   */
+  std::optional<int> code() const;
+
+  /**
+   * The signal which ended the process, if any
+   */
+  std::optional<int> signal() const;
+};
+
+//
+// The captured result of a process which has finished
+//
+struct ProcessOutput {
+  ExitStatus  status;
+  std::string out;
+  std::string err;
+};
+
+//
+// A running child process
+//
+// Children must be waited for (`wait` or `wait_with_output`) to be reaped. Dropping a
+// Child closes its pipes, and reaps it only if it has already exited, so a child dropped
+// while still running is left as a zombie. The pipe ends are owned by the Child, and are -1 unless requested
+//
+class [[nodiscard]] Child {
+public:
+  Child(pid_t pid, int stdin_fd, int stdout_fd, int stderr_fd) :
+      m_pid(pid), m_stdin(stdin_fd), m_stdout(stdout_fd), m_stderr(stderr_fd) {
+  }
+
+  Child(Child&& other);
+  Child& operator=(Child&& other);
+  ~Child();
+
+  pid_t pid() const {
+    return m_pid;
+  }
+
+  int stdin_fd() const {
+    return m_stdin;
+  }
+
+  int stdout_fd() const {
+    return m_stdout;
+  }
+
+  int stderr_fd() const {
+    return m_stderr;
+  }
+
+  /**
+   * Close the child's stdin (if piped), signalling the end of its input
+   */
+  void close_stdin();
+
+  /**
+   * Wait for the child to exit (closing its stdin first, if piped)
+   *
+   * A child can only be waited for once, afterwards (or once moved from) this fails with ECHILD
+   */
+  Result<ExitStatus, ProcessError> wait();
+
+  /**
+   * Read the child's piped stdout and stderr until they close, then wait for it to exit
+   */
+  Result<ProcessOutput, ProcessError> wait_with_output();
+
+private:
+  void m_release();
+
+  pid_t m_pid;
+  int   m_stdin;
+  int   m_stdout;
+  int   m_stderr;
+};
+
+//
+// A reusable description of a process to spawn
+//
+// Processes are started with posix_spawn, which (in glibc and musl) uses a
+// vfork-style clone sharing the parent's memory, so spawning costs the same
+// regardless of the parent's size, unlike fork. The child's environment is an
+// EnvSnapshot, whose envp array is built once and reused by every spawn
+//
+class Command {
+public:
+  enum class Stdio {
+    Inherit, // share the parent's stream
+    Null,    // connect to /dev/null
+    Pipe,    // connect to a pipe, available through the Child
+  };
+
+  /**
+   * The program is searched for in the parent's PATH, unless it contains a '/'
+   */
+  explicit Command(std::string program);
+
+  Command& arg(std::string_view argument);
+  Command& args(std::initializer_list<std::string_view> arguments);
+
+  /**
+   * Set the child's environment (by default, it inherits the parent's environment at the time of spawning)
+   */
+  Command& environment(EnvSnapshot env);
+
+  Command& stdin_mode(Stdio stdio);
+  Command& stdout_mode(Stdio stdio);
+  Command& stderr_mode(Stdio stdio);
+
+  /**
+   * Start the process, with no blocked signals and every signal at its default disposition
+   *
+   * The returned Child must be waited for, see `Child`
+   */
+  [[nodiscard]] Result<Child, ProcessError> spawn() const;
+
+  /**
+   * Run the process to completion, inheriting the configured streams
+   */
+  Result<ExitStatus, ProcessError> status() const;
+
+  /**
+   * Run the process to completion, capturing its stdout and stderr (stdin is connected to /dev/null)
+   */
+  Result<ProcessOutput, ProcessError> output() const;
+
+private:
+  std::vector<std::string>   m_args; // the program is the first argument
+  std::optional<EnvSnapshot> m_env;
+  Stdio                      m_stdin  = Stdio::Inherit;
+  Stdio                      m_stdout = Stdio::Inherit;
+  Stdio                      m_stderr = Stdio::Inherit;
+};
+
+}; // namespace mutils
@@ -22,16 +22,47 @@
 
 #pragma once
 #include "./panic.h"
+#include <cstdint>
+#include <functional>
+#include <new>
 #include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
 
 namespace mutils {
 
+template <typename T, typename E> class Result;
+
+template <typename... Args> class FormatString; // format.h
+
+namespace detail {
+
+// Selects the private constructors which build the value (or error) directly
+// from the return value of a function, so no temporary has to be moved
+struct ResultInvoke {};
+
+// Kept out of line, so that the accessors which may panic stay small enough to inline
+[[noreturn, gnu::cold, gnu::noinline]] inline void result_panic(char const* message) {
+  PANIC(message);
+}
+
+template <typename R> struct is_result_type : std::false_type {};
+template <typename T, typename E> struct is_result_type<Result<T, E>> : std::true_type {};
+
+}; // namespace detail
+
 /**
  * A Simple Result class inspired heavily by rust
+ *
+ * When both T and E are trivially movable and destructible, so is the Result,
+ * which lets the compiler pass and return it in registers
  */
 template <typename T, typename E> class Result {
+  template <typename, typename> friend class Result;
+
 private:
-  enum {
+  enum Variant : uint8_t {
     Good,
     Bad,
   } m_variant;
@@ -41,7 +72,58 @@ private:
     E m_bad;
   };
 
+  static constexpr bool trivially_destructible =
+      std::is_trivially_destructible_v<T> && std::is_trivially_destructible_v<E>;
+  static constexpr bool trivially_movable =
+      std::is_trivially_move_constructible_v<T> && std::is_trivially_move_constructible_v<E>;
+  static constexpr bool trivially_move_assignable = trivially_movable && trivially_destructible &&
+                                                    std::is_trivially_move_assignable_v<T> &&
+                                                    std::is_trivially_move_assignable_v<E>;
+  static constexpr bool nothrow_movable =
+      std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_constructible_v<E>;
+
+  template <typename F, typename... Args>
+  Result(std::in_place_index_t<0>, detail::ResultInvoke, F&& f, Args&&... args) :
+      m_variant(Good), m_good(std::invoke(std::forward<F>(f), std::forward<Args>(args)...)) {
+  }
+
+  template <typename F, typename... Args>
+  Result(std::in_place_index_t<1>, detail::ResultInvoke, F&& f, Args&&... args) :
+      m_variant(Bad), m_bad(std::invoke(std::forward<F>(f), std::forward<Args>(args)...)) {
+  }
+
+  void m_destroy() noexcept {
+    if constexpr (!trivially_destructible) {
+      if (m_variant == Good) {
+        m_good.~T();
+      } else {
+        m_bad.~E();
+      }
+    }
+  }
+
+  void m_construct_from(Result&& other) noexcept(nothrow_movable) {
+    if (other.m_variant == Good) {
+      ::new (static_cast<void*>(&m_good)) T(std::move(other.m_good));
+    } else {
+      ::new (static_cast<void*>(&m_bad)) E(std::move(other.m_bad));
+    }
+    m_variant = other.m_variant;
+  }
+
+  // Errors which can describe themselves (i.e ContextError) are included in the panic message
+  [[noreturn, gnu::cold, gnu::noinline]] void m_panic_with_error() const {
+    if constexpr (requires { std::string(m_bad.toString()); }) {
+      PANIC("Result contained an Error, but was accessed via value_or_panic()\n\t" + std::string(m_bad.toString()));
+    } else {
+      detail::result_panic("Result contained an Error, but was accessed via value_or_panic()");
+    }
+  }
+
 public:
+  using value_type = T;
+  using error_type = E;
+
   /**
    * Construct a Good Result
    */
@@ -50,19 +132,52 @@ public:
 
   /**
    * Construct a Bad Result
+   * (when T and E are the same type, use the std::in_place_index<1> constructor)
    */
-  Result(E error) : m_variant(Bad), m_bad(std::move(error)) {
+  Result(E error)
+    requires(!std::is_same_v<T, E>)
+      : m_variant(Bad), m_bad(std::move(error)) {
+  }
+
+  /**
+   * Construct the value (index 0) or error (index 1) in place
+   * (this also disambiguates Results where T and E are the same type)
+   */
+  template <typename... Args>
+  explicit Result(std::in_place_index_t<0>, Args&&... args) : m_variant(Good), m_good(std::forward<Args>(args)...) {
+  }
+
+  template <typename... Args>
+  explicit Result(std::in_place_index_t<1>, Args&&... args) : m_variant(Bad), m_bad(std::forward<Args>(args)...) {
   }
 
   // Results are move-only
-  Result(Result&&) = default;
+  Result(Result&&)
+    requires trivially_movable
+  = default;
 
-  ~Result() {
-    if (m_variant == Good) {
-      m_good.~T();
-    } else {
-      m_bad.~E();
+  Result(Result&& other) noexcept(nothrow_movable) {
+    m_construct_from(std::move(other));
+  }
+
+  Result& operator=(Result&&)
+    requires trivially_move_assignable
+  = default;
+
+  Result& operator=(Result&& other) noexcept(nothrow_movable) {
+    if (this != &other) {
+      m_destroy();
+      m_construct_from(std::move(other));
     }
+    return *this;
+  }
+
+  ~Result()
+    requires trivially_destructible
+  = default;
+
+  ~Result() {
+    m_destroy();
   }
 
   /**
@@ -70,9 +185,9 @@ public:
    * otherwise, throws the Error using C++ throw keyword
    */
   T value_or_throw() {
-    if (m_variant == Good) {
+    if (m_variant == Good) [[likely]] {
       return std::move(m_good);
-    } else {
+    } else [[unlikely]] {
       throw std::move(m_bad);
     }
   }
@@ -84,10 +199,10 @@ public:
    * **UNRECOVERABLE**
    */
   T value_or_panic() {
-    if (m_variant == Good) {
+    if (m_variant == Good) [[likely]] {
       return std::move(m_good);
-    } else {
-      PANIC("Result contained an Error, but was accessed via value_or_panic()");
+    } else [[unlikely]] {
+      m_panic_with_error();
     }
   }
 
@@ -96,31 +211,340 @@ public:
    * otherwise, returns the provided alternative value
    */
   T value_or(T alternative) {
-    if (m_variant == Good) {
+    if (m_variant == Good) [[likely]] {
       return std::move(m_good);
-    } else {
+    } else [[unlikely]] {
       return std::move(alternative);
     }
   }
 
+  /**
+   * Attach context to the error of a Bad Result, for errors which gather context
+   * (see ContextError in error_context.h). Nothing is formatted until the error is displayed
+   */
+  template <typename... Args>
+  Result with_context(FormatString<std::type_identity_t<Args>...> fmt, Args const&... args) && {
+    if (m_variant == Bad) [[unlikely]] {
+      m_bad.add_context(fmt, args...);
+    }
+    return std::move(*this);
+  }
+
+  template <typename... Args>
+  Result& with_context(FormatString<std::type_identity_t<Args>...> fmt, Args const&... args) & {
+    if (m_variant == Bad) [[unlikely]] {
+      m_bad.add_context(fmt, args...);
+    }
+    return *this;
+  }
+
   bool is_good() const {
     return m_variant == Good;
   }
 
+  /**
+   * Inspect the contained value without consuming the Result,
+   * panics if the Result is not Good
+   */
+  T const& peek_value() const {
+    if (m_variant != Good) [[unlikely]] {
+      detail::result_panic("Result contained an Error, but was accessed via peek_value()");
+    }
+    return m_good;
+  }
+
+  /**
+   * Inspect the contained error without consuming the Result,
+   * panics if the Result is not Bad
+   */
+  E const& peek_error() const {
+    if (m_variant != Bad) [[unlikely]] {
+      detail::result_panic("Result contained a value, but was accessed via peek_error()");
+    }
+    return m_bad;
+  }
+
   std::optional<T> value() {
-    if (m_variant == Good) {
+    if (m_variant == Good) [[likely]] {
       return std::move(m_good);
-    } else {
+    } else [[unlikely]] {
       return {};
     }
   }
 
   std::optional<E> error() {
-    if (m_variant == Bad) {
+    if (m_variant == Bad) [[unlikely]] {
       return std::move(m_bad);
+    } else [[likely]] {
+      return {};
+    }
+  }
+
+  /**
+   * Transform the value of a Good Result with `f(T) -> U`, yielding a Result<U, E>
+   * (the Result is consumed, errors are passed through untouched)
+   */
+  template <typename F> Result<std::invoke_result_t<F, T&&>, E> map(F&& f) {
+    using U = std::invoke_result_t<F, T&&>;
+
+    if (m_variant == Good) [[likely]] {
+      if constexpr (std::is_void_v<U>) {
+        std::invoke(std::forward<F>(f), std::move(m_good));
+        return Result<void, E>();
+      } else {
+        return Result<U, E>(std::in_place_index<0>, detail::ResultInvoke{}, std::forward<F>(f), std::move(m_good));
+      }
+    } else [[unlikely]] {
+      return Result<U, E>(std::in_place_index<1>, std::move(m_bad));
+    }
+  }
+
+  /**
+   * Chain a fallible operation `f(T) -> Result<U, E>` onto a Good Result
+   * (the Result is consumed, errors are passed through untouched)
+   */
+  template <typename F> std::invoke_result_t<F, T&&> and_then(F&& f) {
+    using R = std::invoke_result_t<F, T&&>;
+    static_assert(detail::is_result_type<R>::value && std::is_same_v<typename R::error_type, E>,
+                  "and_then must be given a function which returns a Result with the same error type");
+
+    if (m_variant == Good) [[likely]] {
+      return std::invoke(std::forward<F>(f), std::move(m_good));
+    } else [[unlikely]] {
+      return R(std::in_place_index<1>, std::move(m_bad));
+    }
+  }
+
+  /**
+   * Recover from a Bad Result with `f(E) -> Result<T, E2>`
+   * (the Result is consumed, values are passed through untouched)
+   */
+  template <typename F> std::invoke_result_t<F, E&&> or_else(F&& f) {
+    using R = std::invoke_result_t<F, E&&>;
+    static_assert(detail::is_result_type<R>::value && std::is_same_v<typename R::value_type, T>,
+                  "or_else must be given a function which returns a Result with the same value type");
+
+    if (m_variant == Good) [[likely]] {
+      return R(std::in_place_index<0>, std::move(m_good));
+    } else [[unlikely]] {
+      return std::invoke(std::forward<F>(f), std::move(m_bad));
+    }
+  }
+};
+
+/**
+ * A Result which carries no value, only success or an error
+ */
+template <typename E> class Result<void, E> {
+  template <typename, typename> friend class Result;
+
+private:
+  enum Variant : uint8_t {
+    Good,
+    Bad,
+  } m_variant;
+
+  union {
+    E m_bad;
+  };
+
+  static constexpr bool trivially_destructible     = std::is_trivially_destructible_v<E>;
+  static constexpr bool trivially_movable          = std::is_trivially_move_constructible_v<E>;
+  static constexpr bool trivially_move_assignable  = trivially_movable && trivially_destructible &&
+                                                    std::is_trivially_move_assignable_v<E>;
+  static constexpr bool nothrow_movable            = std::is_nothrow_move_constructible_v<E>;
+
+  template <typename F, typename... Args>
+  Result(std::in_place_index_t<1>, detail::ResultInvoke, F&& f, Args&&... args) :
+      m_variant(Bad), m_bad(std::invoke(std::forward<F>(f), std::forward<Args>(args)...)) {
+  }
+
+  void m_destroy() noexcept {
+    if constexpr (!trivially_destructible) {
+      if (m_variant == Bad) {
+        m_bad.~E();
+      }
+    }
+  }
+
+  void m_construct_from(Result&& other) noexcept(nothrow_movable) {
+    if (other.m_variant == Bad) {
+      ::new (static_cast<void*>(&m_bad)) E(std::move(other.m_bad));
+    }
+    m_variant = other.m_variant;
+  }
+
+  // Errors which can describe themselves (i.e ContextError) are included in the panic message
+  [[noreturn, gnu::cold, gnu::noinline]] void m_panic_with_error() const {
+    if constexpr (requires { std::string(m_bad.toString()); }) {
+      PANIC("Result contained an Error, but was accessed via value_or_panic()\n\t" + std::string(m_bad.toString()));
     } else {
+      detail::result_panic("Result contained an Error, but was accessed via value_or_panic()");
+    }
+  }
+
+public:
+  using value_type = void;
+  using error_type = E;
+
+  /**
+   * Construct a Good Result
+   */
+  Result() : m_variant(Good) {
+  }
+
+  explicit Result(std::in_place_index_t<0>) : m_variant(Good) {
+  }
+
+  /**
+   * Construct a Bad Result
+   */
+  Result(E error) : m_variant(Bad), m_bad(std::move(error)) {
+  }
+
+  template <typename... Args>
+  explicit Result(std::in_place_index_t<1>, Args&&... args) : m_variant(Bad), m_bad(std::forward<Args>(args)...) {
+  }
+
+  // Results are move-only
+  Result(Result&&)
+    requires trivially_movable
+  = default;
+
+  Result(Result&& other) noexcept(nothrow_movable) {
+    m_construct_from(std::move(other));
+  }
+
+  Result& operator=(Result&&)
+    requires trivially_move_assignable
+  = default;
+
+  Result& operator=(Result&& other) noexcept(nothrow_movable) {
+    if (this != &other) {
+      m_destroy();
+      m_construct_from(std::move(other));
+    }
+    return *this;
+  }
+
+  ~Result()
+    requires trivially_destructible
+  = default;
+
+  ~Result() {
+    m_destroy();
+  }
+
+  /**
+   * Throws the Error using C++ throw keyword if the Result is Bad
+   */
+  void value_or_throw() {
+    if (m_variant == Bad) [[unlikely]] {
+      throw std::move(m_bad);
+    }
+  }
+
+  /**
+   * Panics if the Result is Bad
+   *
+   * **UNRECOVERABLE**
+   */
+  void value_or_panic() {
+    if (m_variant == Bad) [[unlikely]] {
+      m_panic_with_error();
+    }
+  }
+
+  /**
+   * Attach context to the error of a Bad Result, for errors which gather context
+   * (see ContextError in error_context.h). Nothing is formatted until the error is displayed
+   */
+  template <typename... Args>
+  Result with_context(FormatString<std::type_identity_t<Args>...> fmt, Args const&... args) && {
+    if (m_variant == Bad) [[unlikely]] {
+      m_bad.add_context(fmt, args...);
+    }
+    return std::move(*this);
+  }
+
+  template <typename... Args>
+  Result& with_context(FormatString<std::type_identity_t<Args>...> fmt, Args const&... args) & {
+    if (m_variant == Bad) [[unlikely]] {
+      m_bad.add_context(fmt, args...);
+    }
+    return *this;
+  }
+
+  bool is_good() const {
+    return m_variant == Good;
+  }
+
+  /**
+   * Inspect the contained error without consuming the Result,
+   * panics if the Result is not Bad
+   */
+  E const& peek_error() const {
+    if (m_variant != Bad) [[unlikely]] {
+      detail::result_panic("Result contained a value, but was accessed via peek_error()");
+    }
+    return m_bad;
+  }
+
+  std::optional<E> error() {
+    if (m_variant == Bad) [[unlikely]] {
+      return std::move(m_bad);
+    } else [[likely]] {
       return {};
     }
   }
+
+  /**
+   * Produce a value from a Good Result with `f() -> U`, yielding a Result<U, E>
+   */
+  template <typename F> Result<std::invoke_result_t<F>, E> map(F&& f) {
+    using U = std::invoke_result_t<F>;
+
+    if (m_variant == Good) [[likely]] {
+      if constexpr (std::is_void_v<U>) {
+        std::invoke(std::forward<F>(f));
+        return Result<void, E>();
+      } else {
+        return Result<U, E>(std::in_place_index<0>, detail::ResultInvoke{}, std::forward<F>(f));
+      }
+    } else [[unlikely]] {
+      return Result<U, E>(std::in_place_index<1>, std::move(m_bad));
+    }
+  }
+
+  /**
+   * Chain a fallible operation `f() -> Result<U, E>` onto a Good Result
+   */
+  template <typename F> std::invoke_result_t<F> and_then(F&& f) {
+    using R = std::invoke_result_t<F>;
+    static_assert(detail::is_result_type<R>::value && std::is_same_v<typename R::error_type, E>,
+                  "and_then must be given a function which returns a Result with the same error type");
+
+    if (m_variant == Good) [[likely]] {
+      return std::invoke(std::forward<F>(f));
+    } else [[unlikely]] {
+      return R(std::in_place_index<1>, std::move(m_bad));
+    }
+  }
+
+  /**
+   * Recover from a Bad Result with `f(E) -> Result<void, E2>`
+   */
+  template <typename F> std::invoke_result_t<F, E&&> or_else(F&& f) {
+    using R = std::invoke_result_t<F, E&&>;
+    static_assert(detail::is_result_type<R>::value && std::is_void_v<typename R::value_type>,
+                  "or_else must be given a function which returns a Result with the same value type");
+
+    if (m_variant == Good) [[likely]] {
+      return R();
+    } else [[unlikely]] {
+      return std::invoke(std::forward<F>(f), std::move(m_bad));
+    }
+  }
 };
+
 } // namespace mutils
@@ -21,49 +21,353 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <ranges>
 #include <span>
 #include <string>
 #include <string_view>
 #include <vector>
-#include<cstring>
 
 namespace mutils::string {
 
+[[nodiscard]] inline bool is_strippable_char(char c) noexcept {
+  return (c >= 1 && c <= 32) || c == 127;
+}
 
-[[nodiscard]] inline std::vector<std::string_view> split(std::string_view s, char sep) noexcept {
-  std::vector<std::string_view> ret;
+//
+// The result of a multi-needle search
+//
+struct FindAnyResult {
+  std::size_t pos;    // The position of the earliest match, npos if there is none
+  std::size_t needle; // The index of the needle which matched
+};
 
-  std::size_t last_idx = 0;
+namespace detail {
+
+//
+// Inputs shorter than this are processed by the inline scalar
+// loops, as the SIMD kernels would not pay for their dispatch
+//
+inline constexpr std::size_t SIMD_THRESHOLD = 16;
+
+//
+// Byte-processing kernels, selected at runtime according to the
+// instruction sets supported by the CPU (AVX-512BW, AVX2, SSE2 or scalar)
+//
+struct StringKernels {
+  void (*to_upper)(char* data, std::size_t n) noexcept;
+  void (*to_lower)(char* data, std::size_t n) noexcept;
+
+  // The number of strippable characters at the start / end of the data
+  std::size_t (*count_strippable_start)(char const* data, std::size_t n) noexcept;
+  std::size_t (*count_strippable_end)(char const* data, std::size_t n) noexcept;
+
+  // Append every `sep`-delimited field of the data to `out`
+  void (*split)(char const* data, std::size_t n, char sep, std::vector<std::string_view>& out);
+
+  // The position of the first occurrence of the (non-empty) needle, or npos
+  std::size_t (*find)(char const* data, std::size_t n, char const* needle, std::size_t m) noexcept;
+
+  // The earliest occurrence of any of the (non-empty) needles
+  FindAnyResult (*find_any)(char const* data, std::size_t n, std::string_view const* needles, std::size_t count) noexcept;
+};
+
+//
+// The largest needle set which the SIMD multi-needle kernels handle,
+// larger sets are searched with the scalar kernel
+//
+inline constexpr std::size_t MAX_SIMD_NEEDLES = 8;
 
-  std::size_t idx = 0;
-  for (auto c : s) {
-    if (c == sep) {
-      auto substr = s.substr(last_idx, idx - last_idx);
-      ret.push_back(substr);
+[[nodiscard]] StringKernels const& kernels() noexcept;
+
+inline void to_upper_scalar(char* data, std::size_t n) noexcept {
+  char const DIFF = 'a' - 'A';
+  for (std::size_t i = 0; i < n; i++) {
+    char& c = data[i];
+    if (c >= 'a' && c <= 'z') {
+      c -= DIFF;
+    }
+  }
+}
+
+inline void to_lower_scalar(char* data, std::size_t n) noexcept {
+  char const DIFF = 'a' - 'A';
+  for (std::size_t i = 0; i < n; i++) {
+    char& c = data[i];
+    if (c >= 'A' && c <= 'Z') {
+      c += DIFF;
+    }
+  }
+}
+
+inline std::size_t count_strippable_start_scalar(char const* data, std::size_t n) noexcept {
+  std::size_t count = 0;
+  while (count < n && is_strippable_char(data[count])) {
+    count++;
+  }
+  return count;
+}
+
+inline std::size_t count_strippable_end_scalar(char const* data, std::size_t n) noexcept {
+  std::size_t count = 0;
+  while (count < n && is_strippable_char(data[n - count - 1])) {
+    count++;
+  }
+  return count;
+}
+
+inline void split_scalar(char const* data, std::size_t n, char sep, std::vector<std::string_view>& out) {
+  std::size_t last_idx = 0;
+  for (std::size_t idx = 0; idx < n; idx++) {
+    if (data[idx] == sep) {
+      out.emplace_back(data + last_idx, idx - last_idx);
       last_idx = idx + 1;
-    } else if (idx == s.size() - 1) {
-      auto substr = s.substr(last_idx, idx - last_idx);
-      ret.push_back(substr);
     }
-    idx++;
+  }
+  out.emplace_back(data + last_idx, n - last_idx);
+}
+
+inline std::size_t find_scalar(char const* data, std::size_t n, char const* needle, std::size_t m) noexcept {
+  return std::string_view(data, n).find(std::string_view(needle, m));
+}
+
+inline FindAnyResult find_any_scalar(char const*             data,
+                                     std::size_t             n,
+                                     std::string_view const* needles,
+                                     std::size_t             count) noexcept {
+  // Only test the needles at positions which hold one of their first bytes
+  uint64_t firsts[4] = {0, 0, 0, 0};
+  for (std::size_t k = 0; k < count; k++) {
+    auto c = static_cast<unsigned char>(needles[k][0]);
+    firsts[c >> 6] |= uint64_t(1) << (c & 63);
+  }
+
+  for (std::size_t pos = 0; pos < n; pos++) {
+    auto c = static_cast<unsigned char>(data[pos]);
+    if (!((firsts[c >> 6] >> (c & 63)) & 1)) {
+      continue;
+    }
+    for (std::size_t k = 0; k < count; k++) {
+      auto needle = needles[k];
+      if (needle.size() <= n - pos && std::memcmp(data + pos, needle.data(), needle.size()) == 0) {
+        return {pos, k};
+      }
+    }
+  }
+  return {std::string_view::npos, 0};
+}
+
+}; // namespace detail
+
+//
+// Split the string_view into the fields delimited by `sep`
+//
+// a string containing N separators always yields N+1 fields
+// (empty fields are retained), an empty string yields no fields
+//
+[[nodiscard]] inline std::vector<std::string_view> split(std::string_view s, char sep) noexcept {
+  std::vector<std::string_view> ret;
+
+  if (s.empty()) {
+    return ret;
+  }
+
+  if (s.size() < detail::SIMD_THRESHOLD) {
+    detail::split_scalar(s.data(), s.size(), sep, ret);
+  } else {
+    detail::kernels().split(s.data(), s.size(), sep, ret);
   }
   return ret;
 }
 
 //
-// Capitalize the contents of the passed string_view
-// returns a newly constructed string representing the
-// transformed content of the view
+// Delimiter which matches any one of a set of characters
 //
-[[nodiscard]] inline std::string capitalize(std::string_view s) noexcept {
-  char const  DIFF = 'a' - 'A';
-  std::string ret  = std::string(s);
-  for (char& c : ret) {
-    if (c >= 'a' && c <= 'z') {
-      c -= DIFF;
+struct AnyOf {
+  uint64_t bits[4] = {0, 0, 0, 0};
+
+  constexpr AnyOf(std::string_view chars) noexcept {
+    for (unsigned char c : chars) {
+      bits[c >> 6] |= uint64_t(1) << (c & 63);
     }
   }
-  return ret;
+
+  [[nodiscard]] constexpr bool contains(char ch) const noexcept {
+    auto c = static_cast<unsigned char>(ch);
+    return (bits[c >> 6] >> (c & 63)) & 1;
+  }
+};
+
+struct SplitOptions {
+  // The maximum number of splits to perform,
+  // the remainder of the string forms the final field
+  std::size_t max_splits = std::string_view::npos;
+
+  // Skip over any empty fields
+  // (empty fields still count towards max_splits)
+  bool skip_empty = false;
+};
+
+namespace detail {
+
+struct DelimiterMatch {
+  std::size_t pos; // npos if there is no further match
+  std::size_t length;
+};
+
+inline DelimiterMatch find_delimiter(std::string_view s, std::size_t from, char delim) noexcept {
+  return {s.find(delim, from), 1};
+}
+
+inline DelimiterMatch find_delimiter(std::string_view s, std::size_t from, std::string_view delim) noexcept {
+  if (delim.empty()) {
+    return {std::string_view::npos, 0};
+  }
+  return {s.find(delim, from), delim.size()};
+}
+
+inline DelimiterMatch find_delimiter(std::string_view s, std::size_t from, AnyOf const& delim) noexcept {
+  for (std::size_t i = from; i < s.size(); i++) {
+    if (delim.contains(s[i])) {
+      return {i, 1};
+    }
+  }
+  return {std::string_view::npos, 1};
+}
+
+}; // namespace detail
+
+//
+// A lazy view over the fields of a string, separated by a delimiter
+//
+// Fields are yielded as string_views into the original string on demand,
+// no allocations are made. Follows the same semantics as `split`
+//
+// The delimiter may be a char, a (multi-char) string_view, or an AnyOf set
+//
+template <typename Delimiter> class SplitView : public std::ranges::view_interface<SplitView<Delimiter>> {
+  std::string_view m_str;
+  Delimiter        m_delim;
+  SplitOptions     m_opts;
+
+public:
+  class Iterator {
+    SplitView const* m_view   = nullptr;
+    std::size_t      m_start  = 0; // start of the current field
+    std::size_t      m_end    = 0; // end of the current field
+    std::size_t      m_next   = 0; // start of the following field, npos if this is the last
+    std::size_t      m_splits = 0;
+    bool             m_done   = true;
+
+    void m_load_field(std::size_t start) noexcept {
+      auto const& str = m_view->m_str;
+      m_start         = start;
+
+      if (m_splits < m_view->m_opts.max_splits) {
+        auto match = detail::find_delimiter(str, start, m_view->m_delim);
+        if (match.pos != std::string_view::npos) {
+          m_end  = match.pos;
+          m_next = match.pos + match.length;
+          m_splits++;
+          return;
+        }
+      }
+      m_end  = str.size();
+      m_next = std::string_view::npos;
+    }
+
+    void m_skip_empty() noexcept {
+      while (!m_done && m_view->m_opts.skip_empty && m_start == m_end) {
+        m_step();
+      }
+    }
+
+    void m_step() noexcept {
+      if (m_next == std::string_view::npos) {
+        m_done = true;
+      } else {
+        m_load_field(m_next);
+      }
+    }
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using iterator_concept  = std::forward_iterator_tag;
+    using difference_type   = std::ptrdiff_t;
+    using value_type        = std::string_view;
+    using reference         = std::string_view;
+
+    Iterator() = default;
+
+    Iterator(SplitView const* view) noexcept : m_view(view), m_done(view->m_str.empty()) {
+      if (!m_done) {
+        m_load_field(0);
+        m_skip_empty();
+      }
+    }
+
+    std::string_view operator*() const noexcept {
+      return m_view->m_str.substr(m_start, m_end - m_start);
+    }
+
+    Iterator& operator++() noexcept {
+      m_step();
+      m_skip_empty();
+      return *this;
+    }
+
+    Iterator operator++(int) noexcept {
+      Iterator tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    friend bool operator==(Iterator const& a, Iterator const& b) noexcept {
+      return a.m_done == b.m_done && (a.m_done || a.m_start == b.m_start);
+    }
+
+    friend bool operator==(Iterator const& it, std::default_sentinel_t) noexcept {
+      return it.m_done;
+    }
+  };
+
+  SplitView() = default;
+
+  SplitView(std::string_view s, Delimiter delim, SplitOptions opts = {}) noexcept :
+      m_str(s), m_delim(std::move(delim)), m_opts(opts) {
+  }
+
+  [[nodiscard]] Iterator begin() const noexcept {
+    return Iterator(this);
+  }
+
+  [[nodiscard]] std::default_sentinel_t end() const noexcept {
+    return std::default_sentinel;
+  }
+};
+
+//
+// Lazily split the string_view into the fields delimited by `sep`
+//
+// unlike `split`, no vector is allocated; the fields are found as
+// the view is iterated. The view must outlive its iterators
+//
+[[nodiscard]] inline SplitView<char> split_view(std::string_view s, char sep, SplitOptions opts = {}) noexcept {
+  return SplitView<char>(s, sep, opts);
+}
+
+[[nodiscard]] inline SplitView<std::string_view> split_view(std::string_view s,
+                                                            std::string_view sep,
+                                                            SplitOptions     opts = {}) noexcept {
+  return SplitView<std::string_view>(s, sep, opts);
+}
+
+[[nodiscard]] inline SplitView<AnyOf> split_view(std::string_view s, AnyOf seps, SplitOptions opts = {}) noexcept {
+  return SplitView<AnyOf>(s, seps, opts);
 }
 
 //
@@ -71,27 +375,43 @@ namespace mutils::string {
 // inplace
 //
 inline void capitalize_inplace(std::span<char> span) noexcept {
+  if (span.size() < detail::SIMD_THRESHOLD) {
+    detail::to_upper_scalar(span.data(), span.size());
+  } else {
+    detail::kernels().to_upper(span.data(), span.size());
+  }
+}
+
+//
+// Append the capitalized contents of the passed string_view
+// to the end of `out`
+//
+inline void capitalize_into(std::string_view s, std::string& out) {
+  auto const start = out.size();
+  out.append(s);
+  capitalize_inplace(std::span<char>(out).subspan(start));
+}
+
+//
+// Write the capitalized contents of the passed string_view
+// to an output iterator, returns the iterator past the last write
+//
+template <std::output_iterator<char> OutputIt> OutputIt capitalize_into(std::string_view s, OutputIt out) {
   char const DIFF = 'a' - 'A';
-  for (char& c : span) {
-    if (c >= 'a' && c <= 'z') {
-      c -= DIFF;
-    }
+  for (char c : s) {
+    *out++ = (c >= 'a' && c <= 'z') ? char(c - DIFF) : c;
   }
+  return out;
 }
 
 //
-// Lowercase the contents of the passed string_view
+// Capitalize the contents of the passed string_view
 // returns a newly constructed string representing the
 // transformed content of the view
 //
-[[nodiscard]] inline std::string lowercase(std::string_view s) noexcept {
-  char const  DIFF = 'a' - 'A';
-  std::string ret  = std::string(s);
-  for (char& c : ret) {
-    if (c >= 'A' && c <= 'Z') {
-      c += DIFF;
-    }
-  }
+[[nodiscard]] inline std::string capitalize(std::string_view s) noexcept {
+  std::string ret;
+  capitalize_into(s, ret);
   return ret;
 }
 
@@ -100,16 +420,97 @@ inline void capitalize_inplace(std::span<char> span) noexcept {
 // inplace
 //
 inline void lowercase_inplace(std::span<char> span) noexcept {
+  if (span.size() < detail::SIMD_THRESHOLD) {
+    detail::to_lower_scalar(span.data(), span.size());
+  } else {
+    detail::kernels().to_lower(span.data(), span.size());
+  }
+}
+
+//
+// Append the lowercased contents of the passed string_view
+// to the end of `out`
+//
+inline void lowercase_into(std::string_view s, std::string& out) {
+  auto const start = out.size();
+  out.append(s);
+  lowercase_inplace(std::span<char>(out).subspan(start));
+}
+
+//
+// Write the lowercased contents of the passed string_view
+// to an output iterator, returns the iterator past the last write
+//
+template <std::output_iterator<char> OutputIt> OutputIt lowercase_into(std::string_view s, OutputIt out) {
   char const DIFF = 'a' - 'A';
-  for (char& c : span) {
-    if (c >= 'A' && c <= 'Z') {
-      c += DIFF;
-    }
+  for (char c : s) {
+    *out++ = (c >= 'A' && c <= 'Z') ? char(c + DIFF) : c;
   }
+  return out;
 }
 
-[[nodiscard]] inline bool is_strippable_char(char c) noexcept {
-  return (c >= 1 && c <= 32) || c == 127;
+//
+// Lowercase the contents of the passed string_view
+// returns a newly constructed string representing the
+// transformed content of the view
+//
+[[nodiscard]] inline std::string lowercase(std::string_view s) noexcept {
+  std::string ret;
+  lowercase_into(s, ret);
+  return ret;
+}
+
+//
+// Strip any trailing and leading whitespace to the string
+//
+// returns a view of the stripped region of `s`, no copy is made
+//
+[[nodiscard]] inline std::string_view strip_view(std::string_view s) noexcept {
+  std::size_t start;
+  std::size_t end;
+
+  if (s.size() < detail::SIMD_THRESHOLD) {
+    start = detail::count_strippable_start_scalar(s.data(), s.size());
+    end   = detail::count_strippable_end_scalar(s.data() + start, s.size() - start);
+  } else {
+    auto const& k = detail::kernels();
+    start         = k.count_strippable_start(s.data(), s.size());
+    end           = k.count_strippable_end(s.data() + start, s.size() - start);
+  }
+
+  return s.substr(start, s.size() - start - end);
+}
+
+//
+// Strip any leading whitespace to the string
+//
+// returns a view of the stripped region of `s`, no copy is made
+//
+[[nodiscard]] inline std::string_view strip_start_view(std::string_view s) noexcept {
+  std::size_t start;
+
+  if (s.size() < detail::SIMD_THRESHOLD) {
+    start = detail::count_strippable_start_scalar(s.data(), s.size());
+  } else {
+    start = detail::kernels().count_strippable_start(s.data(), s.size());
+  }
+  return s.substr(start);
+}
+
+inline void strip_into(std::string_view s, std::string& out) {
+  out.append(strip_view(s));
+}
+
+template <std::output_iterator<char> OutputIt> OutputIt strip_into(std::string_view s, OutputIt out) {
+  return std::ranges::copy(strip_view(s), out).out;
+}
+
+inline void strip_start_into(std::string_view s, std::string& out) {
+  out.append(strip_start_view(s));
+}
+
+template <std::output_iterator<char> OutputIt> OutputIt strip_start_into(std::string_view s, OutputIt out) {
+  return std::ranges::copy(strip_start_view(s), out).out;
 }
 
 //
@@ -121,65 +522,399 @@ inline void lowercase_inplace(std::span<char> span) noexcept {
 // returns a new stripped string
 //
 [[nodiscard]] inline std::string strip(std::string_view s) noexcept{
-  std::size_t start = 0;
+  return std::string(strip_view(s));
+}
 
-  for (char c : s) {
-    if (is_strippable_char(c)) {
-      start++;
-    } else {
-      break;
-    }
+[[nodiscard]] inline std::string strip_start(std::string_view s) noexcept{
+  return std::string(strip_start_view(s));
+};
+
+inline void pad_start_into(std::string_view s, char with, size_t n, std::string& out) {
+  out.append(n, with);
+  out.append(s);
+}
+
+template <std::output_iterator<char> OutputIt>
+OutputIt pad_start_into(std::string_view s, char with, size_t n, OutputIt out) {
+  out = std::fill_n(out, n, with);
+  return std::ranges::copy(s, out).out;
+}
+
+[[nodiscard]] inline std::string pad_start(std::string_view s, char with, size_t n) noexcept{
+  std::string ret;
+  ret.reserve(n + s.size());
+  pad_start_into(s, with, n, ret);
+  return ret;
+};
+
+namespace detail {
+
+struct CenterPadding {
+  std::size_t before;
+  std::size_t after;
+};
+
+inline CenterPadding center_padding(std::size_t length, std::size_t cols) noexcept {
+  if (cols <= length) {
+    return {0, 0};
   }
+  const auto remainder = cols - length;
 
-  std::size_t size = s.size() - start;
+  // Imperfect alignment places the extra column before the text
+  const auto pad_count = remainder >> 1;
+  return {pad_count + (remainder & 1), pad_count};
+}
 
-  for (auto c = s.rbegin(); c < s.rend(); c++) {
-    if (size == 0) {
-      break;
-    }
+}; // namespace detail
 
-    if (is_strippable_char(*c)) {
-      size--;
-    } else {
-      break;
-    }
+inline void center_into(std::string_view s, size_t cols, std::string& out) {
+  auto pad = detail::center_padding(s.size(), cols);
+  out.append(pad.before, ' ');
+  out.append(s);
+  out.append(pad.after, ' ');
+}
+
+template <std::output_iterator<char> OutputIt> OutputIt center_into(std::string_view s, size_t cols, OutputIt out) {
+  auto pad = detail::center_padding(s.size(), cols);
+  out      = std::fill_n(out, pad.before, ' ');
+  out      = std::ranges::copy(s, out).out;
+  return std::fill_n(out, pad.after, ' ');
+}
+
+//
+// Center the string within `cols` columns, by padding either side with spaces
+//
+// strings which are already at least `cols` wide are returned unchanged
+//
+[[nodiscard]] inline std::string center(std::string_view s, size_t cols) noexcept{
+  std::string ret;
+  ret.reserve(cols > s.size() ? cols : s.size());
+  center_into(s, cols, ret);
+  return ret;
+}
+
+//
+// Find the first occurrence of `needle` within `s`, starting from `from`
+//
+// returns the position of the match, or npos if there is none
+//
+[[nodiscard]] inline std::size_t find(std::string_view s, std::string_view needle, std::size_t from = 0) noexcept {
+  if (from > s.size() || needle.size() > s.size() - from) {
+    return std::string_view::npos;
+  }
+  if (needle.empty()) {
+    return from;
   }
-  return std::string(s.substr(start, size));
+
+  std::size_t pos;
+  if (s.size() - from < detail::SIMD_THRESHOLD) {
+    pos = detail::find_scalar(s.data() + from, s.size() - from, needle.data(), needle.size());
+  } else {
+    pos = detail::kernels().find(s.data() + from, s.size() - from, needle.data(), needle.size());
+  }
+  return pos == std::string_view::npos ? pos : pos + from;
 }
 
-[[nodiscard]] inline std::string strip_start(std::string_view s) noexcept{
-  std::size_t start = 0;
+[[nodiscard]] inline bool contains(std::string_view s, std::string_view needle) noexcept {
+  return find(s, needle) != std::string_view::npos;
+}
+
+//
+// Append the position of every (non-overlapping) occurrence of `needle` to `out`
+//
+inline void find_all_into(std::string_view s, std::string_view needle, std::vector<std::size_t>& out) {
+  if (needle.empty()) {
+    return;
+  }
+  for (std::size_t pos = find(s, needle); pos != std::string_view::npos; pos = find(s, needle, pos + needle.size())) {
+    out.push_back(pos);
+  }
+}
 
-  for(char c : s){
-    if(is_strippable_char(c)){
-      start++;
+//
+// Find the position of every (non-overlapping) occurrence of `needle` within `s`
+//
+[[nodiscard]] inline std::vector<std::size_t> find_all(std::string_view s, std::string_view needle) {
+  std::vector<std::size_t> ret;
+  find_all_into(s, needle, ret);
+  return ret;
+}
+
+//
+// Find the earliest occurrence of any of the `needles` within `s`, starting from `from`
+//
+// if multiple needles match at the same position, the first of them is reported.
+// Intended for small needle sets, where each needle is tested simultaneously
+//
+[[nodiscard]] inline FindAnyResult find_any(std::string_view                  s,
+                                            std::span<std::string_view const> needles,
+                                            std::size_t                       from = 0) noexcept {
+  if (from > s.size()) {
+    return {std::string_view::npos, 0};
+  }
+  for (std::size_t k = 0; k < needles.size(); k++) {
+    if (needles[k].empty()) {
+      return {from, k};
     }
-    else{
-      break;
+  }
+  if (needles.empty()) {
+    return {std::string_view::npos, 0};
+  }
+
+  char const* data = s.data() + from;
+  std::size_t n    = s.size() - from;
+
+  FindAnyResult ret;
+  if (n < detail::SIMD_THRESHOLD || needles.size() > detail::MAX_SIMD_NEEDLES) {
+    ret = detail::find_any_scalar(data, n, needles.data(), needles.size());
+  } else {
+    ret = detail::kernels().find_any(data, n, needles.data(), needles.size());
+  }
+
+  if (ret.pos != std::string_view::npos) {
+    ret.pos += from;
+  }
+  return ret;
+}
+
+[[nodiscard]] inline bool contains_any(std::string_view s, std::span<std::string_view const> needles) noexcept {
+  return find_any(s, needles).pos != std::string_view::npos;
+}
+
+//
+// Append `s` to `out`, with every (non-overlapping) occurrence of `from` replaced by `to`
+//
+// the output is sized exactly once, before any data is written
+//
+inline void replace_all_into(std::string_view s, std::string_view from, std::string_view to, std::string& out) {
+  auto const start = out.size();
+
+  if (from.empty()) {
+    out.append(s);
+    return;
+  }
+
+  // Same-length replacements can be patched over a plain copy
+  if (from.size() == to.size()) {
+    out.append(s);
+    char* data = out.data() + start;
+    for (std::size_t pos = find(s, from); pos != std::string_view::npos; pos = find(s, from, pos + from.size())) {
+      std::memcpy(data + pos, to.data(), to.size());
     }
+    return;
   }
-  return std::string(s.substr(start));
-};
 
-[[nodiscard]] inline std::string pad_start(std::string_view s, char with, size_t n) noexcept{
-  std::string ret(n, with);
-  ret.append(s);
+  std::vector<std::size_t> matches;
+  find_all_into(s, from, matches);
+  if (matches.empty()) {
+    out.append(s);
+    return;
+  }
+
+  out.resize(start + s.size() - matches.size() * from.size() + matches.size() * to.size());
+
+  char*       cursor = out.data() + start;
+  std::size_t last   = 0;
+  for (std::size_t pos : matches) {
+    std::memcpy(cursor, s.data() + last, pos - last);
+    cursor += pos - last;
+    std::memcpy(cursor, to.data(), to.size());
+    cursor += to.size();
+    last = pos + from.size();
+  }
+  std::memcpy(cursor, s.data() + last, s.size() - last);
+}
+
+//
+// Replace every (non-overlapping) occurrence of `from` within `s` by `to`
+//
+// returns a newly constructed string, which is allocated exactly once
+//
+[[nodiscard]] inline std::string replace_all(std::string_view s, std::string_view from, std::string_view to) {
+  std::string ret;
+  replace_all_into(s, from, to, ret);
   return ret;
+}
+
+//
+// Fused transformation pipelines
+//
+// Stages are composed with `operator|`, and the whole pipeline is then
+// evaluated without materializing any intermediate strings, i.e
+//
+//   constexpr auto normalize = fused::strip | fused::lowercase | fused::split(',');
+//   normalize(line, buffer, fields);
+//
+// - view stages (strip, strip_start) only narrow the input, and never copy
+// - map stages (lowercase, capitalize) are applied in place within `buffer`
+// - a split stage must come last, and emits views into the transformed data
+//
+// `buffer` and `fields` are overwritten and may be reused between calls,
+// so a warmed-up pipeline performs no allocations
+//
+namespace fused {
+
+struct StripStage {
+  static constexpr bool is_view = true;
+
+  static std::string_view view(std::string_view s) noexcept {
+    return strip_view(s);
+  }
 };
 
-[[nodiscard]] inline std::string center(std::string_view s, size_t cols) noexcept{
-  const auto remainder = cols - s.size();
+struct StripStartStage {
+  static constexpr bool is_view = true;
+
+  static std::string_view view(std::string_view s) noexcept {
+    return strip_start_view(s);
+  }
+};
+
+struct LowercaseStage {
+  static constexpr bool is_view = false;
 
-  if((remainder & 1) == 0){
-    // Perfect alignment
-    const auto pad_count = remainder >> 2;
-    return pad_start(s, ' ', pad_count) + std::string(pad_count, ' ');
+  static void map(std::span<char> data) noexcept {
+    lowercase_inplace(data);
   }
-  else{
-    // Imperfect alignment, slighly align left
-    const auto pad_count = remainder >> 2;
-    return pad_start(s, ' ', pad_count + 1) + std::string(pad_count, ' ');
+};
+
+struct CapitalizeStage {
+  static constexpr bool is_view = false;
+
+  static void map(std::span<char> data) noexcept {
+    capitalize_inplace(data);
   }
+};
+
+struct SplitStage {
+  char sep;
+};
+
+template <typename... Stages> struct Pipeline;
+
+template <typename T> inline constexpr bool is_stage = false;
+
+template <> inline constexpr bool is_stage<StripStage>      = true;
+template <> inline constexpr bool is_stage<StripStartStage> = true;
+template <> inline constexpr bool is_stage<LowercaseStage>  = true;
+template <> inline constexpr bool is_stage<CapitalizeStage> = true;
+
+inline constexpr StripStage      strip{};
+inline constexpr StripStartStage strip_start{};
+inline constexpr LowercaseStage  lowercase{};
+inline constexpr CapitalizeStage capitalize{};
+
+[[nodiscard]] constexpr SplitStage split(char sep) noexcept {
+  return SplitStage{sep};
+}
+
+//
+// A pipeline of view and map stages
+//
+template <typename... Stages> struct Pipeline {
+  static constexpr bool has_map = (!Stages::is_view || ...);
+
+  // View stages only narrow the input, and do not depend on case,
+  // so they can all be applied before any mapping takes place
+  static std::string_view apply_views(std::string_view s) noexcept {
+    ((s = view_one<Stages>(s)), ...);
+    return s;
+  }
+
+  template <typename Stage> static std::string_view view_one(std::string_view s) noexcept {
+    if constexpr (Stage::is_view) {
+      return Stage::view(s);
+    } else {
+      return s;
+    }
+  }
+
+  template <typename Stage> static void map_one(std::span<char> data) noexcept {
+    if constexpr (!Stage::is_view) {
+      Stage::map(data);
+    }
+  }
+
+  //
+  // Copy `s` to `out`, and apply the map stages to it
+  //
+  static void map_into(std::string_view s, char* out) noexcept {
+    std::memcpy(out, s.data(), s.size());
+    (map_one<Stages>(std::span<char>(out, s.size())), ...);
+  }
+
+  //
+  // Run the pipeline over `s`, returning a view of the result
+  //
+  // the result points into `s` if the pipeline contains no map stages,
+  // otherwise into `buffer`
+  //
+  std::string_view operator()(std::string_view s, std::string& buffer) const {
+    s = apply_views(s);
+    if constexpr (!has_map) {
+      return s;
+    } else {
+      buffer.resize(s.size());
+      map_into(s, buffer.data());
+      return buffer;
+    }
+  }
+};
+
+//
+// A pipeline terminated by a split stage
+//
+template <typename... Stages> struct SplitPipeline {
+  SplitStage splitter;
+
+  void operator()(std::string_view s, std::string& buffer, std::vector<std::string_view>& fields) const {
+    using Base = Pipeline<Stages...>;
+
+    fields.clear();
+    s = Base::apply_views(s);
+
+    if (s.empty()) {
+      return;
+    }
+
+    // The mapped bytes are still hot in L1 when the split kernel scans them,
+    // which is considerably faster than testing for the separator while mapping
+    if constexpr (Base::has_map) {
+      buffer.resize(s.size());
+      Base::map_into(s, buffer.data());
+      s = buffer;
+    }
+
+    if (s.size() < detail::SIMD_THRESHOLD) {
+      detail::split_scalar(s.data(), s.size(), splitter.sep, fields);
+    } else {
+      detail::kernels().split(s.data(), s.size(), splitter.sep, fields);
+    }
+  }
+};
+
+template <typename A, typename B>
+  requires is_stage<A> && is_stage<B>
+constexpr Pipeline<A, B> operator|(A, B) noexcept {
+  return {};
+}
+
+template <typename... Stages, typename B>
+  requires is_stage<B>
+constexpr Pipeline<Stages..., B> operator|(Pipeline<Stages...>, B) noexcept {
+  return {};
 }
 
+template <typename A>
+  requires is_stage<A>
+constexpr SplitPipeline<A> operator|(A, SplitStage split) noexcept {
+  return {split};
+}
+
+template <typename... Stages> constexpr SplitPipeline<Stages...> operator|(Pipeline<Stages...>, SplitStage split) noexcept {
+  return {split};
+}
+
+}; // namespace fused
+
 }; // namespace mutils::string
@@ -21,11 +21,26 @@
 
 #pragma once
 
+#include "./enum.h"
+#include "./result.h"
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstring>
 #include <iomanip>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <ranges>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <type_traits>
-#include<ostream>
+#include <utility>
+#include <variant>
+
 namespace mutils {
 
 
@@ -41,30 +56,451 @@ concept IsStreamable = requires(T val, std::ostream& ss) { ss << val; };
 template <typename T>
 concept IsStringCastable = std::is_convertible_v<T, std::string>;
 
+
+//
+// A growable character buffer, which stores up to `InlineBytes` characters
+// inline before spilling onto the heap
+//
+// Intended to be reused: `clear()` keeps the buffer's capacity, so once a
+// buffer has grown to fit a typical message, formatting into it allocates nothing
+//
+template <std::size_t InlineBytes = 256> class StringBuffer {
+  char                    m_inline[InlineBytes];
+  std::unique_ptr<char[]> m_heap;
+  char*                   m_data     = m_inline;
+  std::size_t             m_size     = 0;
+  std::size_t             m_capacity = InlineBytes;
+
+public:
+  StringBuffer() = default;
+
+  StringBuffer(StringBuffer const&)            = delete;
+  StringBuffer& operator=(StringBuffer const&) = delete;
+
+  StringBuffer(StringBuffer&& other) noexcept {
+    m_steal(other);
+  }
+
+  StringBuffer& operator=(StringBuffer&& other) noexcept {
+    if (this != &other) {
+      m_heap.reset();
+      m_steal(other);
+    }
+    return *this;
+  }
+
+  void append(char const* data, std::size_t n) {
+    if (m_capacity - m_size < n) {
+      reserve(m_size + n);
+    }
+    std::memcpy(m_data + m_size, data, n);
+    m_size += n;
+  }
+
+  void append(std::string_view s) {
+    append(s.data(), s.size());
+  }
+
+  void push_back(char c) {
+    if (m_size == m_capacity) {
+      reserve(m_size + 1);
+    }
+    m_data[m_size++] = c;
+  }
+
+  StringBuffer& operator+=(std::string_view s) {
+    append(s);
+    return *this;
+  }
+
+  StringBuffer& operator+=(char c) {
+    push_back(c);
+    return *this;
+  }
+
+  /**
+   * Ensure the buffer can hold at least `n` characters without reallocating
+   */
+  void reserve(std::size_t n) {
+    if (n <= m_capacity) {
+      return;
+    }
+    std::size_t capacity = m_capacity * 2 > n ? m_capacity * 2 : n;
+    auto        grown    = std::make_unique<char[]>(capacity);
+    std::memcpy(grown.get(), m_data, m_size);
+    m_heap     = std::move(grown);
+    m_data     = m_heap.get();
+    m_capacity = capacity;
+  }
+
+  /**
+   * Empty the buffer, retaining its capacity
+   */
+  void clear() {
+    m_size = 0;
+  }
+
+  char const* data() const {
+    return m_data;
+  }
+
+  std::size_t size() const {
+    return m_size;
+  }
+
+  std::size_t capacity() const {
+    return m_capacity;
+  }
+
+  bool empty() const {
+    return m_size == 0;
+  }
+
+  std::string_view view() const {
+    return std::string_view(m_data, m_size);
+  }
+
+  std::string str() const {
+    return std::string(m_data, m_size);
+  }
+
+  operator std::string_view() const {
+    return view();
+  }
+
+private:
+  void m_steal(StringBuffer& other) noexcept {
+    if (other.m_heap) {
+      m_heap     = std::move(other.m_heap);
+      m_data     = m_heap.get();
+      m_capacity = other.m_capacity;
+    } else {
+      std::memcpy(m_inline, other.m_inline, other.m_size);
+      m_data     = m_inline;
+      m_capacity = InlineBytes;
+    }
+    m_size           = other.m_size;
+    other.m_data     = other.m_inline;
+    other.m_size     = 0;
+    other.m_capacity = InlineBytes;
+  }
+};
+
+//
+// Any growable character buffer which stringify_to can append into,
+// such as std::string or mutils::StringBuffer
+//
+template <typename B>
+concept IsStringBuffer = requires(B& buf, char const* data, std::size_t n, char c) {
+  buf.append(data, n);
+  buf.push_back(c);
+};
+
+//
+// Types which have a string form of their own
+//
 template <typename T>
-std::string stringify(T val)
-  requires std::is_same_v<T, char>
-{
+concept IsDirectlyStringifiable = std::is_same_v<T, char> || IsStringCastable<T> || IsSTLToStringCompatible<T> ||
+                                  IsJavaStyleStringCastable<T> || IsStreamable<T> || std::is_enum_v<T>;
+
+//
+// Enums which are stringified by the name of their enumerator (see enum.h)
+// Scoped enums with their own `operator<<` are streamed instead
+//
+template <typename T>
+concept IsScopedEnum = std::is_enum_v<T> && (!std::is_convertible_v<T, std::underlying_type_t<T>>);
+
+template <typename T>
+concept IsReflectedEnum = std::is_enum_v<T> && !(IsScopedEnum<T> && IsStreamable<T>);
+
+namespace detail {
+
+template <typename T> struct is_optional : std::false_type {};
+template <typename T> struct is_optional<std::optional<T>> : std::true_type {};
+
+template <typename T> struct is_variant : std::false_type {};
+template <typename... Ts> struct is_variant<std::variant<Ts...>> : std::true_type {};
+
+}; // namespace detail
+
+//
+// Containers of values, which are stringified element by element
+// (types which already have a string form, such as std::string, are not treated as ranges)
+//
+template <typename T>
+concept IsStringifiableRange = std::ranges::input_range<T const> && (!IsDirectlyStringifiable<T>);
+
+template <typename T>
+concept IsStringifiableTuple = requires { std::tuple_size<T>::value; } && (!IsStringifiableRange<T>) &&
+                               (!IsDirectlyStringifiable<T>);
+
+template <typename T>
+concept IsStringifiable = IsDirectlyStringifiable<T> || IsStringifiableRange<T> || IsStringifiableTuple<T> ||
+                          detail::is_optional<T>::value || detail::is_variant<T>::value ||
+                          detail::is_result_type<T>::value || std::is_same_v<T, std::monostate>;
+
+//
+// Controls how compound values (containers, tuples, etc.) are stringified
+//
+struct StringifyOptions {
+  // Placed between the elements of containers and tuples
+  std::string_view separator = ", ";
+
+  // The maximum number of elements to print from each container,
+  // the remainder are summarised as "... (N more)"
+  std::size_t max_items = std::size_t(-1);
+};
+
+namespace detail {
+
+// Enough room for any integer (including the sign) in base 10
+inline constexpr std::size_t STRINGIFY_INTEGER_CHARS = 40;
+
+// Enough room for most floats in any notation, larger outputs fall back to the heap
+inline constexpr std::size_t STRINGIFY_FLOAT_CHARS = 64;
+
+template <IsStringBuffer B> void stringify_char_to(B& buf, char val) {
   unsigned char c = val;
 
   // unprintable ascii / represent as hex bytes
   if (c <= 31 || c >= 127) {
-    std::stringstream ss;
-    ss << std::hex << (int)c;
-    return "\\0x" + ss.str();
+    char digits[8] = {'\\', '0', 'x'};
+    auto result    = std::to_chars(digits + 3, digits + sizeof(digits), int(c), 16);
+    buf.append(digits, std::size_t(result.ptr - digits));
   }
   // backslash / use double backslash to disambiguate from hex bytes
   else if (c == '\\') {
-    return "\\\\";
+    buf.append("\\\\", 2);
   }
   // default case, just stringify
   else {
-    std::string ret;
-    ret += c;
-    return ret;
+    buf.push_back(val);
+  }
+}
+
+}; // namespace detail
+
+//
+// The notation used to format floating point numbers
+//
+enum class FloatNotation {
+  General,    // whichever of Fixed and Scientific is shorter
+  Fixed,      // 1234.5
+  Scientific, // 1.2345e+03
+};
+
+namespace detail {
+
+inline std::chars_format chars_format_of(FloatNotation notation) {
+  switch (notation) {
+  case FloatNotation::Fixed:
+    return std::chars_format::fixed;
+  case FloatNotation::Scientific:
+    return std::chars_format::scientific;
+  default:
+    return std::chars_format::general;
   }
 }
 
+// Format into a stack buffer, only very long (i.e fixed notation of huge
+// or tiny values) outputs need to be formatted on the heap
+template <IsStringBuffer B, typename Format> void float_to(B& buf, Format&& format) {
+  char digits[STRINGIFY_FLOAT_CHARS];
+  auto result = format(digits, digits + sizeof(digits));
+  if (result.ec == std::errc()) {
+    buf.append(digits, std::size_t(result.ptr - digits));
+    return;
+  }
+
+  std::string heap(sizeof(digits) * 4, '\0');
+  while ((result = format(heap.data(), heap.data() + heap.size())).ec != std::errc()) {
+    heap.resize(heap.size() * 4);
+  }
+  buf.append(heap.data(), std::size_t(result.ptr - heap.data()));
+}
+
+}; // namespace detail
+
+//
+// Append the shortest representation of 'val' which parses back to exactly 'val'
+//
+// i.e 0.1 is formatted as "0.1" (rather than "0.100000" or "0.10000000000000001").
+// Uses `std::to_chars`, so never consults the locale
+//
+template <IsStringBuffer B, std::floating_point F>
+void format_float_to(B& buf, F val, FloatNotation notation = FloatNotation::General) {
+  if (notation == FloatNotation::General) {
+    detail::float_to(buf, [val](char* first, char* last) { return std::to_chars(first, last, val); });
+  } else {
+    auto format = detail::chars_format_of(notation);
+    detail::float_to(buf, [val, format](char* first, char* last) { return std::to_chars(first, last, val, format); });
+  }
+}
+
+//
+// Append 'val' with `precision` digits after the decimal point
+// (or `precision` significant digits, for FloatNotation::General)
+//
+template <IsStringBuffer B, std::floating_point F>
+void format_float_to(B& buf, F val, FloatNotation notation, int precision) {
+  auto format = detail::chars_format_of(notation);
+  detail::float_to(buf, [=](char* first, char* last) { return std::to_chars(first, last, val, format, precision); });
+}
+
+template <std::floating_point F> std::string format_float(F val, FloatNotation notation = FloatNotation::General) {
+  std::string ret;
+  format_float_to(ret, val, notation);
+  return ret;
+}
+
+template <std::floating_point F> std::string format_float(F val, FloatNotation notation, int precision) {
+  std::string ret;
+  format_float_to(ret, val, notation, precision);
+  return ret;
+}
+
+//
+// Append the string representation of 'val' onto the end of 'buf'
+//
+// produces the same text as `stringify(val)`, but numbers and characters are
+// formatted on the stack with `std::to_chars`, and strings are appended directly,
+// so (once the buffer has grown) no allocation is made
+//
+// floats are formatted with the shortest representation that round-trips (see `format_float_to`)
+//
+// compound values are streamed into the same buffer, element by element:
+// - containers as `[a, b, c]`
+// - pairs and tuples as `(a, b)`
+// - optionals as their value, or `none`
+// - variants as their active alternative
+// - Results as `Good(value)` (or `Good`, for Result<void, E>) or `Bad(error)`
+//
+template <IsStringBuffer B, typename T>
+  requires IsStringifiable<std::remove_cvref_t<T>>
+void stringify_to(B& buf, T&& val, StringifyOptions const& opts = {}) {
+  using U = std::remove_cvref_t<T>;
+
+  if constexpr (IsStringifiableRange<U>) {
+    buf.push_back('[');
+    std::size_t printed = 0;
+    auto        it      = std::ranges::begin(std::as_const(val));
+    auto        end     = std::ranges::end(std::as_const(val));
+    for (; it != end && printed < opts.max_items; ++it, ++printed) {
+      if (printed) {
+        buf.append(opts.separator.data(), opts.separator.size());
+      }
+      stringify_to(buf, *it, opts);
+    }
+    if (it != end) {
+      if (printed) {
+        buf.append(opts.separator.data(), opts.separator.size());
+      }
+      // Only count the remaining elements if it is cheap (or at least, non-destructive) to do so
+      if constexpr (std::ranges::sized_range<U const>) {
+        buf.append("... (", 5);
+        stringify_to(buf, std::size_t(std::ranges::size(val)) - printed);
+        buf.append(" more)", 6);
+      } else if constexpr (std::ranges::forward_range<U const>) {
+        buf.append("... (", 5);
+        stringify_to(buf, std::size_t(std::ranges::distance(it, end)));
+        buf.append(" more)", 6);
+      } else {
+        buf.append("...", 3);
+      }
+    }
+    buf.push_back(']');
+  } else if constexpr (IsStringifiableTuple<U>) {
+    buf.push_back('(');
+    std::apply(
+        [&](auto const&... elems) {
+          bool first = true;
+          ((first ? void(first = false) : void(buf.append(opts.separator.data(), opts.separator.size())),
+            stringify_to(buf, elems, opts)),
+           ...);
+        },
+        val);
+    buf.push_back(')');
+  } else if constexpr (detail::is_optional<U>::value) {
+    if (val) {
+      stringify_to(buf, *val, opts);
+    } else {
+      buf.append("none", 4);
+    }
+  } else if constexpr (detail::is_variant<U>::value) {
+    if (val.valueless_by_exception()) {
+      buf.append("valueless", 9);
+    } else {
+      std::visit([&](auto const& alt) { stringify_to(buf, alt, opts); }, val);
+    }
+  } else if constexpr (std::is_same_v<U, std::monostate>) {
+    buf.append("monostate", 9);
+  } else if constexpr (detail::is_result_type<U>::value) {
+    if (val.is_good()) {
+      if constexpr (std::is_void_v<typename U::value_type>) {
+        buf.append("Good", 4);
+        return;
+      } else {
+        buf.append("Good(", 5);
+        stringify_to(buf, val.peek_value(), opts);
+      }
+    } else {
+      buf.append("Bad(", 4);
+      stringify_to(buf, val.peek_error(), opts);
+    }
+    buf.push_back(')');
+  } else if constexpr (std::is_same_v<U, char>) {
+    detail::stringify_char_to(buf, val);
+  } else if constexpr (std::is_convertible_v<T, std::string_view> && (IsStringCastable<U> || IsStreamable<U>)) {
+    std::string_view view = val;
+    buf.append(view.data(), view.size());
+  } else if constexpr (IsReflectedEnum<U>) {
+    // Values which do not name an enumerator are printed as integers
+    if (auto name = enum_name(val); !name.empty()) {
+      buf.append(name.data(), name.size());
+    } else {
+      stringify_to(buf, std::underlying_type_t<U>(val));
+    }
+  } else if constexpr (IsStringCastable<U>) {
+    std::string str(std::forward<T>(val));
+    buf.append(str.data(), str.size());
+  } else if constexpr (IsSTLToStringCompatible<U> && std::is_same_v<U, bool>) {
+    buf.push_back(val ? '1' : '0');
+  } else if constexpr (IsSTLToStringCompatible<U> && std::is_integral_v<U>) {
+    char digits[detail::STRINGIFY_INTEGER_CHARS];
+    auto result = std::to_chars(digits, digits + sizeof(digits), val);
+    buf.append(digits, std::size_t(result.ptr - digits));
+  } else if constexpr (IsSTLToStringCompatible<U> && std::is_floating_point_v<U>) {
+    format_float_to(buf, val);
+  } else if constexpr (IsSTLToStringCompatible<U>) {
+    std::string str = std::to_string(val);
+    buf.append(str.data(), str.size());
+  } else if constexpr (IsJavaStyleStringCastable<U>) {
+    std::string str;
+    if constexpr (requires { str = val.toString(); }) {
+      str = val.toString();
+    } else {
+      // toString is not const-qualified, so call it on a copy (as stringify does)
+      U copy = val;
+      str    = copy.toString();
+    }
+    buf.append(str.data(), str.size());
+  } else {
+    std::stringstream ss;
+    ss << val;
+    std::string str = ss.str();
+    buf.append(str.data(), str.size());
+  }
+}
+
+template <typename T>
+std::string stringify(T val)
+  requires std::is_same_v<T, char>
+{
+  std::string ret;
+  detail::stringify_char_to(ret, val);
+  return ret;
+}
+
 //
 // Cast the 'val' to a string using the `operator std::string` function
 //
@@ -78,13 +514,29 @@ std::string stringify(T val)
 
 //
 // Cast the 'val' to a string using the `std::to_string` function
+// (arithmetic types are formatted with `std::to_chars` instead, and
+// floats use the shortest representation which round-trips)
 //
 
 template <typename T>
 std::string stringify(T val)
   requires IsSTLToStringCompatible<T> && (!IsStringCastable<T>) && (!std::is_same_v<T, char>)
 {
-  return std::to_string(val);
+  std::string ret;
+  stringify_to(ret, val);
+  return ret;
+}
+
+//
+// Cast the 'val' to the name of its enumerator
+//
+template <typename T>
+std::string stringify(T val)
+  requires IsReflectedEnum<T> && (!IsSTLToStringCompatible<T>)
+{
+  std::string ret;
+  stringify_to(ret, val);
+  return ret;
 }
 
 //
@@ -114,4 +566,17 @@ std::string stringify(T val)
   return ss.str();
 }
 
+//
+// Cast containers, tuples, optionals, variants and Results to a string
+// (see `stringify_to` for the format)
+//
+template <typename T>
+std::string stringify(T const& val, StringifyOptions const& opts = {})
+  requires IsStringifiable<T> && (!IsDirectlyStringifiable<T>)
+{
+  std::string ret;
+  stringify_to(ret, val, opts);
+  return ret;
+}
+
 }; // namespace mutils
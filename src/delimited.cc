@@ -0,0 +1,159 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+#include "../include/mutils/delimited.h"
+#include "../include/mutils/string.h"
+#include <cstring>
+
+using namespace mutils;
+
+static char unescape(char c) {
+  switch (c) {
+  case 't':
+    return '\t';
+  case 'n':
+    return '\n';
+  case 'r':
+    return '\r';
+  default:
+    return c;
+  }
+}
+
+bool RecordReader::next() {
+  if (m_cursor >= m_data.size()) {
+    return false;
+  }
+
+  char const* start = m_data.data() + m_cursor;
+  std::size_t rest  = m_data.size() - m_cursor;
+
+  auto const* newline = static_cast<char const*>(std::memchr(start, '\n', rest));
+  std::size_t length  = newline ? std::size_t(newline - start) : rest;
+
+  // Most records contain no quotes or escapes, and can be split in place.
+  // Quoted fields may span lines, so are handled by the (slower) state machine
+  bool special = (m_format.quote && std::memchr(start, m_format.quote, length)) ||
+                 (m_format.escape && m_format.escape != m_format.quote && std::memchr(start, m_format.escape, length));
+
+  if (special) {
+    m_next_quoted();
+  } else {
+    m_next_plain(std::string_view(start, length));
+    m_cursor += newline ? length + 1 : length;
+  }
+
+  m_record++;
+  return true;
+}
+
+void RecordReader::m_next_plain(std::string_view line) {
+  if (!line.empty() && line.back() == '\r') {
+    line.remove_suffix(1);
+  }
+
+  m_fields.clear();
+  if (line.empty()) {
+    return;
+  }
+
+  if (line.size() < string::detail::SIMD_THRESHOLD) {
+    string::detail::split_scalar(line.data(), line.size(), m_format.delimiter, m_fields);
+  } else {
+    string::detail::kernels().split(line.data(), line.size(), m_format.delimiter, m_fields);
+  }
+}
+
+void RecordReader::m_next_quoted() {
+  char const  quote     = m_format.quote;
+  char const  escape    = m_format.escape != quote ? m_format.escape : '\0';
+  char const  delimiter = m_format.delimiter;
+  char const* data      = m_data.data();
+  std::size_t n         = m_data.size();
+  std::size_t pos       = m_cursor;
+
+  m_scratch.clear();
+  m_spans.clear();
+
+  std::size_t field_start = 0;
+  bool        quoted      = false;
+  bool        any         = false; // whether the record has any content, a blank line has no fields
+
+  while (pos < n) {
+    char c = data[pos];
+
+    if (escape && c == escape && pos + 1 < n) {
+      m_scratch.push_back(unescape(data[pos + 1]));
+      pos += 2;
+      any = true;
+      continue;
+    }
+
+    if (quoted) {
+      if (c == quote) {
+        // A doubled quote is a literal quote (when the quote is its own escape)
+        if (m_format.escape == quote && pos + 1 < n && data[pos + 1] == quote) {
+          m_scratch.push_back(quote);
+          pos += 2;
+        } else {
+          quoted = false;
+          pos++;
+        }
+      } else {
+        m_scratch.push_back(c);
+        pos++;
+      }
+      continue;
+    }
+
+    if (quote && c == quote) {
+      quoted = true;
+      any    = true;
+      pos++;
+    } else if (c == delimiter) {
+      m_spans.push_back({field_start, m_scratch.size() - field_start});
+      field_start = m_scratch.size();
+      any         = true;
+      pos++;
+    } else if (c == '\n') {
+      break;
+    } else if (c == '\r' && (pos + 1 == n || data[pos + 1] == '\n')) {
+      pos++;
+    } else {
+      m_scratch.push_back(c);
+      any = true;
+      pos++;
+    }
+  }
+
+  if (any) {
+    m_spans.push_back({field_start, m_scratch.size() - field_start});
+  }
+
+  // Skip over the terminating newline
+  m_cursor = pos < n ? pos + 1 : n;
+
+  m_fields.clear();
+  for (auto span : m_spans) {
+    m_fields.emplace_back(m_scratch.data() + span.offset, span.length);
+  }
+}
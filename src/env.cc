@@ -28,7 +28,11 @@
 //
 
 #include "../include/mutils/env.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <stdlib.h>
 using namespace mutils;
 
@@ -39,33 +43,19 @@ using namespace mutils;
 
 const char *mp_get_environ_var(const char *vname) { return getenv(vname); }
 
-std::vector<std::string> mp_get_all_env_vars() {
-
+// Visit each `NAME=value` entry of the environment
+template <typename Fn> void mp_for_each_environ_entry(Fn &&fn) {
   char *e = GetEnvironmentStrings();
-
-  std::vector<std::string> values;
-
-  char *cursor = e;
-  std::string val;
-  bool write = true;
-  while (true) {
-    if (*cursor == 0 && *(cursor + 1) == 0)
-      break;
-
-    if (*cursor == '=') {
-      write = false;
-      values.push_back(val);
-    }
-
-    if (write)
-      val += *cursor;
-
-    if (*cursor == 0)
-      write = true;
+  for (char *entry = e; *entry != 0; entry += std::strlen(entry) + 1) {
+    fn(entry);
   }
-
   FreeEnvironmentStrings(e);
-  return values;
+}
+
+// The position of the '=' separating an entry's name from its value, or nullptr
+// (names of hidden per-drive variables begin with '=', i.e `=C:=C:\`)
+const char *mp_find_separator(const char *entry) {
+  return *entry ? std::strchr(entry + 1, '=') : nullptr;
 }
 
 void mp_unset_environ_var(const char *vname) {
@@ -76,6 +66,8 @@ void mp_set_environ_var(const char *vname, const char *vvalue) {
   SetEnvironmentVariable(vname, vvalue);
 }
 
+std::vector<std::string> mp_get_all_env_vars();
+
 void mp_clear_environ_vars() {
   for (std::string var : mp_get_all_env_vars()) {
     mp_unset_environ_var(var.c_str());
@@ -102,20 +94,16 @@ void mp_set_environ_var(const char *vname, const char *vvalue) {
 // Unset a specific var
 void mp_unset_environ_var(const char *vname) { unsetenv(vname); }
 
-std::vector<std::string> mp_get_all_env_vars() {
-
-  std::vector<std::string> variables;
-
+// Visit each `NAME=value` entry of the environment
+template <typename Fn> void mp_for_each_environ_entry(Fn &&fn) {
   for (char **element = environ; *element != 0; element++) {
-    char *var = *element;
-    std::string vname = "";
-    for (char *c = var; *c != 0 && *c != '='; c++) {
-      vname += *c;
-    }
-    variables.push_back(vname);
+    fn(*element);
   }
+}
 
-  return variables;
+// The position of the '=' separating an entry's name from its value, or nullptr
+const char *mp_find_separator(const char *entry) {
+  return std::strchr(entry, '=');
 }
 
 // Clear all vars
@@ -123,12 +111,23 @@ void mp_clear_environ_vars() { clearenv(); }
 
 #endif
 
+std::vector<std::string> mp_get_all_env_vars() {
+  std::vector<std::string> variables;
+
+  mp_for_each_environ_entry([&](const char *entry) {
+    const char *separator = mp_find_separator(entry);
+    variables.emplace_back(entry, separator ? separator - entry : std::strlen(entry));
+  });
+
+  return variables;
+}
+
 void ProgramEnvironment::clear() { mp_clear_environ_vars(); }
 
 ProgramEnvironment::EnvEntry
 ProgramEnvironment::operator[](std::string var_name) {
   ProgramEnvironment::EnvEntry env;
-  env.name = var_name;
+  env.name = std::move(var_name);
   return env;
 }
 
@@ -147,3 +146,385 @@ std::vector<std::string> ProgramEnvironment::list_vars() {
 
   return mp_get_all_env_vars();
 }
+
+EnvSnapshot ProgramEnvironment::snapshot() { return EnvSnapshot::capture(); }
+
+//
+// Snapshots
+//
+
+EnvSnapshot::EnvSnapshot() : EnvSnapshot(std::span<Variable const>()) {}
+
+EnvSnapshot::EnvSnapshot(std::span<Variable const> variables) {
+  auto table = std::make_shared<Table>();
+
+  std::size_t bytes = 0;
+  for (auto var : variables) {
+    bytes += var.name.size() + var.value.size() + 2;
+  }
+
+  // Keep the table at most half full
+  std::size_t slot_count = 8;
+  while (slot_count < variables.size() * 2) {
+    slot_count *= 2;
+  }
+
+  table->storage = std::make_unique<char[]>(bytes);
+  table->slots.assign(slot_count, 0);
+  table->mask = slot_count - 1;
+  table->variables.reserve(variables.size());
+  table->envp.reserve(variables.size() + 1);
+
+  char *cursor = table->storage.get();
+  for (auto var : variables) {
+    std::size_t i = hash(var.name) & table->mask;
+    bool duplicate = false;
+    for (; table->slots[i] != 0; i = (i + 1) & table->mask) {
+      if (table->variables[table->slots[i] - 1].name == var.name) {
+        duplicate = true;
+        break;
+      }
+    }
+    if (duplicate) {
+      continue;
+    }
+
+    char *entry = cursor;
+    cursor = std::copy(var.name.begin(), var.name.end(), cursor);
+    *cursor++ = '=';
+    cursor = std::copy(var.value.begin(), var.value.end(), cursor);
+    *cursor++ = '\0';
+
+    table->variables.push_back({std::string_view(entry, var.name.size()),
+                                std::string_view(entry + var.name.size() + 1, var.value.size())});
+    table->envp.push_back(entry);
+    table->slots[i] = uint32_t(table->variables.size());
+  }
+  table->envp.push_back(nullptr);
+
+  m_table = std::move(table);
+}
+
+EnvSnapshot EnvSnapshot::capture() {
+  std::vector<Variable> variables;
+
+  mp_for_each_environ_entry([&](const char *entry) {
+    const char *separator = mp_find_separator(entry);
+    if (separator) {
+      variables.push_back({std::string_view(entry, separator - entry), std::string_view(separator + 1)});
+    } else {
+      variables.push_back({std::string_view(entry), std::string_view()});
+    }
+  });
+
+  return EnvSnapshot(variables);
+}
+
+static std::string_view trim(std::string_view text) {
+  auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+  while (!text.empty() && is_space(text.front())) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && is_space(text.back())) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+// Whether `text` equals `lower` (which must be lowercase), ignoring case
+static bool equals_lowercase(std::string_view text, std::string_view lower) {
+  return text.size() == lower.size() && std::equal(text.begin(), text.end(), lower.begin(), [](char a, char b) {
+           return (a >= 'A' && a <= 'Z' ? char(a - 'A' + 'a') : a) == b;
+         });
+}
+
+std::optional<int64_t> EnvSnapshot::get_int(std::string_view name) const {
+  auto value = get(name);
+  if (!value) {
+    return std::nullopt;
+  }
+
+  std::string_view text = trim(*value);
+  if (!text.empty() && text.front() == '+') {
+    text.remove_prefix(1);
+    // from_chars accepts a leading '-', which must not follow the '+'
+    if (!text.empty() && (text.front() == '-' || text.front() == '+')) {
+      return std::nullopt;
+    }
+  }
+
+  int64_t result;
+  auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), result);
+  if (ec != std::errc() || ptr != text.data() + text.size()) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+std::optional<bool> EnvSnapshot::get_bool(std::string_view name) const {
+  auto value = get(name);
+  if (!value) {
+    return std::nullopt;
+  }
+
+  std::string_view text = trim(*value);
+  for (std::string_view truthy : {"1", "true", "yes", "on"}) {
+    if (equals_lowercase(text, truthy)) {
+      return true;
+    }
+  }
+  for (std::string_view falsy : {"0", "false", "no", "off"}) {
+    if (equals_lowercase(text, falsy)) {
+      return false;
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<std::chrono::nanoseconds> EnvSnapshot::get_duration(std::string_view name) const {
+  auto value = get(name);
+  if (!value) {
+    return std::nullopt;
+  }
+
+  std::string_view text = trim(*value);
+  if (text == "0") {
+    return std::chrono::nanoseconds(0);
+  }
+  if (text.empty()) {
+    return std::nullopt;
+  }
+
+  struct Unit {
+    std::string_view suffix;
+    double           nanoseconds;
+  };
+  // Two-letter units come first, so `ms` is not read as minutes
+  static constexpr Unit units[] = {
+      {"ns", 1}, {"us", 1e3}, {"ms", 1e6}, {"s", 1e9}, {"m", 60e9}, {"h", 3600e9},
+  };
+
+  double total = 0;
+  while (!text.empty()) {
+    double number;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), number, std::chars_format::fixed);
+    // from_chars also parses `inf` and `nan`
+    if (ec != std::errc() || !std::isfinite(number) || number < 0) {
+      return std::nullopt;
+    }
+    text.remove_prefix(std::size_t(ptr - text.data()));
+
+    auto unit = std::find_if(std::begin(units), std::end(units), [&](Unit const &u) { return text.starts_with(u.suffix); });
+    if (unit == std::end(units)) {
+      return std::nullopt;
+    }
+    text.remove_prefix(unit->suffix.size());
+    total += number * unit->nanoseconds;
+  }
+
+  if (!(total < 9.2e18)) {
+    return std::nullopt;
+  }
+  return std::chrono::nanoseconds(int64_t(total + 0.5));
+}
+
+std::optional<uint64_t> EnvSnapshot::get_size(std::string_view name) const {
+  auto value = get(name);
+  if (!value) {
+    return std::nullopt;
+  }
+
+  std::string_view text = trim(*value);
+  uint64_t bytes;
+  auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), bytes);
+  if (ec != std::errc()) {
+    return std::nullopt;
+  }
+  text.remove_prefix(std::size_t(ptr - text.data()));
+
+  unsigned shift = 0;
+  if (!text.empty()) {
+    switch (text.front()) {
+    case 'k':
+    case 'K':
+      shift = 10;
+      break;
+    case 'm':
+    case 'M':
+      shift = 20;
+      break;
+    case 'g':
+    case 'G':
+      shift = 30;
+      break;
+    case 't':
+    case 'T':
+      shift = 40;
+      break;
+    }
+    if (shift) {
+      text.remove_prefix(1);
+      if (equals_lowercase(text, "ib")) {
+        text.remove_prefix(2);
+      }
+    }
+    if (equals_lowercase(text, "b")) {
+      text.remove_prefix(1);
+    }
+  }
+
+  if (!text.empty() || (shift && bytes > (UINT64_MAX >> shift))) {
+    return std::nullopt;
+  }
+  return bytes << shift;
+}
+
+EnvSnapshot EnvSnapshot::with(std::span<Variable const> overrides) const {
+  EnvSnapshot replacements(overrides);
+
+  std::vector<Variable> variables;
+  variables.reserve(size() + replacements.size());
+  for (auto var : replacements) {
+    variables.push_back(var);
+  }
+  for (auto var : *this) {
+    if (!replacements.contains(var.name)) {
+      variables.push_back(var);
+    }
+  }
+  return EnvSnapshot(variables);
+}
+
+EnvSnapshot EnvSnapshot::without(std::span<std::string_view const> names) const {
+  std::vector<Variable> removed;
+  removed.reserve(names.size());
+  for (auto name : names) {
+    removed.push_back({name, {}});
+  }
+  EnvSnapshot excluded(removed);
+
+  std::vector<Variable> variables;
+  variables.reserve(size());
+  for (auto var : *this) {
+    if (!excluded.contains(var.name)) {
+      variables.push_back(var);
+    }
+  }
+  return EnvSnapshot(variables);
+}
+
+//
+// Managed environments
+//
+
+ManagedEnvironment::ManagedEnvironment() : ManagedEnvironment(EnvSnapshot::capture()) {}
+
+ManagedEnvironment::ManagedEnvironment(EnvSnapshot initial)
+    : m_current(new Version(std::move(initial.m_table))) {}
+
+ManagedEnvironment::~ManagedEnvironment() {
+  delete m_current.load();
+  for (auto &retired : m_retired) {
+    delete retired.version;
+  }
+}
+
+EnvSnapshot ManagedEnvironment::snapshot() const {
+  // While counted as a reader, the loaded version cannot be freed. The epoch is checked
+  // again once counted, a reader of an epoch which has since been advanced past retries
+  uint64_t epoch;
+  while (true) {
+    epoch = m_epoch.load();
+    m_readers[epoch & 1].fetch_add(1);
+    if (m_epoch.load() == epoch) {
+      break;
+    }
+    m_readers[epoch & 1].fetch_sub(1);
+  }
+  EnvSnapshot snapshot(*m_current.load());
+  m_readers[epoch & 1].fetch_sub(1, std::memory_order_release);
+
+  // Without further publishes, versions still waiting are freed by later readers
+  if (m_retired_count.load(std::memory_order_relaxed) != 0) {
+    std::unique_lock lock(m_write_lock, std::try_to_lock);
+    if (lock) {
+      m_reclaim();
+    }
+  }
+  return snapshot;
+}
+
+void ManagedEnvironment::m_publish(EnvSnapshot next) {
+  // The caller holds the write lock
+  auto *previous = m_current.exchange(new Version(std::move(next.m_table)));
+  m_retired.push_back({previous, m_epoch.load()});
+  m_version.fetch_add(1, std::memory_order_release);
+  m_reclaim();
+}
+
+void ManagedEnvironment::m_reclaim() const {
+  // The caller holds the write lock
+  //
+  // Readers which start from here on load the new version. A reader which loaded a version
+  // retired in epoch `e` started in `e` or before, so once the epoch has been advanced
+  // to `e + 2` (each time after the readers of the previous epoch finished) none is left
+  for (int i = 0; i < 2; i++) {
+    uint64_t epoch = m_epoch.load();
+    if (m_readers[(epoch + 1) & 1].load() != 0) {
+      break;
+    }
+    m_epoch.store(epoch + 1);
+  }
+
+  uint64_t epoch = m_epoch.load();
+  auto     kept  = std::partition(m_retired.begin(), m_retired.end(), [&](Retired const &retired) {
+    return retired.epoch + 2 > epoch;
+  });
+  for (auto it = kept; it != m_retired.end(); ++it) {
+    delete it->version;
+  }
+  m_retired.erase(kept, m_retired.end());
+  m_retired_count.store(m_retired.size(), std::memory_order_relaxed);
+}
+
+void ManagedEnvironment::set(std::string_view name, std::string_view value) {
+  EnvSnapshot::Variable var{name, value};
+  set(std::span(&var, 1));
+}
+
+void ManagedEnvironment::set(std::span<EnvSnapshot::Variable const> variables) {
+  std::lock_guard lock(m_write_lock);
+  m_publish(EnvSnapshot(*m_current.load()).with(variables));
+}
+
+void ManagedEnvironment::unset(std::string_view name) { unset(std::span(&name, 1)); }
+
+void ManagedEnvironment::unset(std::span<std::string_view const> names) {
+  std::lock_guard lock(m_write_lock);
+  m_publish(EnvSnapshot(*m_current.load()).without(names));
+}
+
+void ManagedEnvironment::clear() { reset(EnvSnapshot()); }
+
+void ManagedEnvironment::reset(EnvSnapshot snapshot) {
+  std::lock_guard lock(m_write_lock);
+  m_publish(std::move(snapshot));
+}
+
+void ManagedEnvironment::sync_to_process() const {
+  EnvSnapshot target = snapshot();
+  EnvSnapshot process = EnvSnapshot::capture();
+
+  // Names are followed by '=' rather than a terminator, so are copied (values are terminated)
+  for (auto var : process) {
+    if (!target.contains(var.name)) {
+      mp_unset_environ_var(std::string(var.name).c_str());
+    }
+  }
+  for (auto var : target) {
+    auto current = process.get(var.name);
+    if (!current || *current != var.value) {
+      mp_set_environ_var(std::string(var.name).c_str(), var.value.data());
+    }
+  }
+}
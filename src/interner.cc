@@ -0,0 +1,127 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+#include "../include/mutils/interner.h"
+#include "../include/mutils/panic.h"
+#include <cstring>
+
+using namespace mutils;
+
+const std::size_t INTERNER_INITIAL_SLOTS = 64;
+const std::size_t INTERNER_ARENA_CHUNK   = 64 * 1024;
+
+std::unique_ptr<string::Interner::Table> string::Interner::m_make_table(std::size_t slot_count) {
+  auto table   = std::make_unique<Table>();
+  table->mask  = slot_count - 1;
+  table->slots = std::make_unique<std::atomic<uint64_t>[]>(slot_count);
+  for (std::size_t i = 0; i < slot_count; i++) {
+    table->slots[i].store(0, std::memory_order_relaxed);
+  }
+  return table;
+}
+
+void string::Interner::m_place_slot(Table& table, uint64_t h, uint64_t slot) {
+  std::size_t i = h & table.mask;
+  while (table.slots[i].load(std::memory_order_relaxed) != 0) {
+    i = (i + 1) & table.mask;
+  }
+  table.slots[i].store(slot, std::memory_order_release);
+}
+
+string::Interner::Interner() {
+  for (auto& shard : m_shards) {
+    shard.tables.push_back(m_make_table(INTERNER_INITIAL_SLOTS));
+    shard.table.store(shard.tables.back().get(), std::memory_order_release);
+  }
+  for (auto& segment : m_segments) {
+    segment.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+string::Interner::~Interner() {
+  for (auto& segment : m_segments) {
+    delete[] segment.load(std::memory_order_relaxed);
+  }
+}
+
+string::Symbol string::Interner::m_insert(std::string_view s, uint64_t h) {
+  Shard&          shard = m_shards[h >> 60];
+  std::lock_guard guard(shard.lock);
+
+  // Another producer may have interned the string while we waited for the lock
+  if (auto sym = m_find(s, h)) {
+    return *sym;
+  }
+
+  Table* table = shard.table.load(std::memory_order_relaxed);
+
+  // Keep the load factor at or below 1/2, so probe sequences stay short.
+  // The old table is retired rather than freed, as readers may still be probing it
+  if ((shard.count + 1) * 2 > table->mask + 1) {
+    auto grown = m_make_table((table->mask + 1) * 2);
+    for (std::size_t i = 0; i <= table->mask; i++) {
+      uint64_t slot = table->slots[i].load(std::memory_order_relaxed);
+      if (slot != 0) {
+        m_place_slot(*grown, hash(resolve(Symbol{uint32_t(slot) - 1})), slot);
+      }
+    }
+    table = grown.get();
+    shard.tables.push_back(std::move(grown));
+    shard.table.store(table, std::memory_order_release);
+  }
+
+  // Copy the string into the shard's arena
+  if (shard.arena_capacity - shard.arena_used < s.size()) {
+    shard.arena_capacity = s.size() > INTERNER_ARENA_CHUNK ? s.size() : INTERNER_ARENA_CHUNK;
+    shard.arena_used     = 0;
+    shard.arena.push_back(std::make_unique<char[]>(shard.arena_capacity));
+  }
+  char* data = shard.arena.empty() ? nullptr : shard.arena.back().get() + shard.arena_used;
+  if (!s.empty()) {
+    std::memcpy(data, s.data(), s.size());
+  }
+  shard.arena_used += s.size();
+
+  uint32_t id = m_next_id.fetch_add(1, std::memory_order_acq_rel);
+  if (id == UINT32_MAX) {
+    PANIC("String interner has exhausted its 32-bit symbol space");
+  }
+
+  // Make sure the symbol's segment exists, racing producers from other shards may also create it
+  auto              loc     = m_locate(id);
+  std::string_view* segment = m_segments[loc.segment].load(std::memory_order_acquire);
+  if (!segment) {
+    auto* fresh = new std::string_view[std::size_t(1) << (FIRST_SEGMENT_BITS + loc.segment)];
+    if (m_segments[loc.segment].compare_exchange_strong(segment, fresh, std::memory_order_acq_rel)) {
+      segment = fresh;
+    } else {
+      delete[] fresh;
+    }
+  }
+  segment[loc.offset] = std::string_view(data, s.size());
+
+  // Publishing the slot makes both the string and its segment entry visible to readers
+  m_place_slot(*table, h, (uint64_t(uint32_t(h >> 32)) << 32) | (uint64_t(id) + 1));
+  shard.count++;
+
+  return Symbol{id};
+}
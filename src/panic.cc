@@ -0,0 +1,310 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+
+#include "../include/mutils/panic.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef WIN32
+#  include <io.h>
+#  include <windows.h>
+#  define write _write
+#  define STDERR_FILENO 2
+#else
+#  include <csignal>
+#  include <unistd.h>
+#  if __has_include(<execinfo.h>)
+#    include <execinfo.h>
+#    define MUTILS_HAVE_BACKTRACE
+#  endif
+#endif
+
+using namespace mutils;
+
+namespace {
+
+std::atomic<PanicHook>   panic_hooks[MAX_PANIC_HOOKS];
+std::atomic<std::size_t> panic_hook_count{0};
+
+// Set by the first thread to panic, which is the only one to use the report buffer
+std::atomic<bool> panicking{false};
+
+// Set on a thread once it has begun panicking, to catch panics from within the panic path
+thread_local bool panicking_thread = false;
+
+void write_fully(int fd, char const* data, std::size_t size) {
+  while (size) {
+    auto written = write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    data += written;
+    size -= std::size_t(written);
+  }
+}
+
+//
+// Formats the panic report into a static buffer, writing it out whenever it fills
+// (nothing here allocates, locks, or touches the stdio buffers)
+//
+class PanicWriter {
+  static constexpr std::size_t CAPACITY = 4096;
+
+  char        m_buffer[CAPACITY];
+  std::size_t m_size = 0;
+
+public:
+  void append(std::string_view text) {
+    while (!text.empty()) {
+      std::size_t n = std::min(text.size(), CAPACITY - m_size);
+      std::memcpy(m_buffer + m_size, text.data(), n);
+      m_size += n;
+      text.remove_prefix(n);
+      if (m_size == CAPACITY) {
+        flush();
+      }
+    }
+  }
+
+  void append_number(uint64_t value, unsigned base = 10) {
+    char        digits[24];
+    std::size_t n = 0;
+    do {
+      digits[sizeof(digits) - ++n] = "0123456789abcdef"[value % base];
+      value /= base;
+    } while (value);
+    if (base == 16) {
+      append("0x");
+    }
+    append(std::string_view(digits + sizeof(digits) - n, n));
+  }
+
+  void flush() {
+    write_fully(STDERR_FILENO, m_buffer, m_size);
+    m_size = 0;
+  }
+};
+
+PanicWriter panic_writer;
+
+#ifdef MUTILS_HAVE_BACKTRACE
+// The first call to backtrace() loads the unwinder (which allocates), so it is made
+// during static initialization rather than from within a panic
+const bool backtrace_loaded = [] {
+  void* frame;
+  return backtrace(&frame, 1) >= 0;
+}();
+#endif
+
+[[noreturn]] void wait_for_panic() {
+  while (true) {
+#ifdef WIN32
+    Sleep(INFINITE);
+#else
+    pause();
+#endif
+  }
+}
+
+//
+// Report a panic and end the process, `skip` frames (besides this one)
+// are omitted from the backtrace. If `signal` is non-zero, the process is ended by that signal
+//
+[[noreturn, gnu::noinline]] void panic_with(std::string_view msg, std::size_t skip, int signal) {
+  if (panicking_thread) {
+    constexpr std::string_view recursive = "\npanicked while panicking, aborting\n";
+    write_fully(STDERR_FILENO, recursive.data(), recursive.size());
+    abort();
+  }
+  panicking_thread = true;
+
+  if (panicking.exchange(true)) {
+    wait_for_panic();
+  }
+
+  panic_writer.append("\033[0;31;1mpanic:  \033[0;0m");
+  panic_writer.append(msg);
+  panic_writer.append("\n");
+
+#ifdef MUTILS_HAVE_BACKTRACE
+  void* frames[Backtrace::MAX_FRAMES];
+  int   count = backtrace(frames, int(Backtrace::MAX_FRAMES));
+  skip        = std::min(skip + 1, std::size_t(count));
+
+  // Frames are written unsymbolized (module, nearest exported symbol, and address), for addr2line and friends
+  panic_writer.append("backtrace:\n");
+  panic_writer.flush();
+  backtrace_symbols_fd(frames + skip, count - int(skip), STDERR_FILENO);
+#endif
+  panic_writer.flush();
+
+  std::size_t hooks = std::min(panic_hook_count.load(std::memory_order_acquire), MAX_PANIC_HOOKS);
+  for (std::size_t i = 0; i < hooks; i++) {
+    if (auto hook = panic_hooks[i].load(std::memory_order_acquire)) {
+      hook();
+    }
+  }
+
+#ifndef WIN32
+  if (signal) {
+    // Re-raise with the default disposition, so the exit status reflects the original signal
+    // (the signal is blocked while its handler runs, so must be unblocked to be delivered)
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, signal);
+    std::signal(signal, SIG_DFL);
+    sigprocmask(SIG_UNBLOCK, &set, nullptr);
+    raise(signal);
+  }
+#endif
+  abort();
+}
+
+#ifndef WIN32
+constexpr std::size_t CRASH_STACK_SIZE = 64 * 1024;
+
+// The calling thread's alternate stack, disabled before it is freed on thread exit
+struct CrashStack {
+  char* memory = nullptr;
+
+  ~CrashStack() {
+    if (memory == nullptr) return;
+    stack_t stack{};
+    stack.ss_flags = SS_DISABLE;
+    sigaltstack(&stack, nullptr);
+    delete[] memory;
+  }
+};
+thread_local CrashStack crash_stack;
+
+void crash_handler(int signal, siginfo_t* info, void*) {
+  // The message is built on the (alternate) stack, the report buffer belongs to panic_with
+  char        message[96];
+  std::size_t size = 0;
+
+  auto put = [&](std::string_view text) {
+    std::size_t n = std::min(text.size(), sizeof(message) - size);
+    std::memcpy(message + size, text.data(), n);
+    size += n;
+  };
+
+  put(signal == SIGSEGV ? "segmentation fault" : "bus error");
+  put(" accessing 0x");
+  auto address = uintptr_t(info->si_addr);
+  for (int shift = int(sizeof(address) * 8) - 4; shift >= 0; shift -= 4) {
+    message[size++] = "0123456789abcdef"[(address >> shift) & 0xf];
+  }
+
+  // Omit this handler, and the kernel's signal trampoline
+  panic_with(std::string_view(message, size), 2, signal);
+}
+#endif
+
+}; // namespace
+
+[[noreturn]] void mutils::PANIC(std::string_view msg) {
+  // Not called from a signal handler, so output which is still buffered is written out first
+  // (the crash handler skips this, and reports straight from the async-signal-safe path)
+  std::cout.flush();
+  std::fflush(nullptr);
+  panic_with(msg, 1, 0);
+}
+
+bool mutils::add_panic_hook(PanicHook hook) {
+  std::size_t index = panic_hook_count.load(std::memory_order_relaxed);
+  do {
+    if (index >= MAX_PANIC_HOOKS) {
+      return false;
+    }
+  } while (!panic_hook_count.compare_exchange_weak(index, index + 1, std::memory_order_relaxed));
+
+  // A panic between reserving the slot and filling it skips the hook
+  panic_hooks[index].store(hook, std::memory_order_release);
+  return true;
+}
+
+void mutils::install_crash_stack() {
+#ifndef WIN32
+  stack_t stack{};
+  if (sigaltstack(nullptr, &stack) == 0 && !(stack.ss_flags & SS_DISABLE)) return;
+
+  crash_stack.memory = new char[CRASH_STACK_SIZE];
+  stack.ss_sp        = crash_stack.memory;
+  stack.ss_size      = CRASH_STACK_SIZE;
+  stack.ss_flags     = 0;
+  if (sigaltstack(&stack, nullptr) != 0) {
+    delete[] crash_stack.memory;
+    crash_stack.memory = nullptr;
+  }
+#endif
+}
+
+void mutils::install_crash_handlers() {
+#ifndef WIN32
+  install_crash_stack();
+
+  struct sigaction action {};
+  action.sa_sigaction = crash_handler;
+  action.sa_flags     = SA_SIGINFO | SA_ONSTACK;
+  sigemptyset(&action.sa_mask);
+
+  sigaction(SIGSEGV, &action, nullptr);
+  sigaction(SIGBUS, &action, nullptr);
+#endif
+}
+
+[[gnu::noinline]] Backtrace Backtrace::capture(std::size_t skip) {
+  Backtrace trace;
+#ifdef MUTILS_HAVE_BACKTRACE
+  int count = backtrace(trace.m_frames, int(MAX_FRAMES));
+  skip      = std::min(skip + 1, std::size_t(count));
+
+  trace.m_size = std::size_t(count) - skip;
+  std::memmove(trace.m_frames, trace.m_frames + skip, trace.m_size * sizeof(void*));
+#else
+  (void)skip;
+#endif
+  return trace;
+}
+
+std::vector<std::string> Backtrace::symbolize() const {
+  std::vector<std::string> symbols;
+#ifdef MUTILS_HAVE_BACKTRACE
+  char** names = backtrace_symbols(m_frames, int(m_size));
+  if (!names) {
+    return symbols;
+  }
+  symbols.assign(names, names + m_size);
+  std::free(names);
+#endif
+  return symbols;
+}
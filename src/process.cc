@@ -0,0 +1,325 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+
+#include "../include/mutils/process.h"
+
+#ifndef WIN32
+
+#  include <cerrno>
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <signal.h>
+#  include <spawn.h>
+#  include <sys/wait.h>
+#  include <system_error>
+#  include <unistd.h>
+
+extern char** environ;
+
+using namespace mutils;
+
+static void close_fd(int& fd) {
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+std::string ProcessError::toString() const {
+  std::string message;
+  switch (kind) {
+    case Spawn:
+      message = "failed to spawn process: ";
+      break;
+    case Pipe:
+      message = "failed to create a pipe to the process: ";
+      break;
+    case Read:
+      message = "failed to read the output of the process: ";
+      break;
+    case Wait:
+      message = "failed to wait for the process: ";
+      break;
+  }
+  return message + std::generic_category().message(error);
+}
+
+//
+// Exit statuses
+//
+
+bool ExitStatus::success() const {
+  return WIFEXITED(raw) && WEXITSTATUS(raw) == 0;
+}
+
+std::optional<int> ExitStatus::code() const {
+  if (WIFEXITED(raw)) {
+    return WEXITSTATUS(raw);
+  }
+  return std::nullopt;
+}
+
+std::optional<int> ExitStatus::signal() const {
+  if (WIFSIGNALED(raw)) {
+    return WTERMSIG(raw);
+  }
+  return std::nullopt;
+}
+
+//
+// Children
+//
+
+Child::Child(Child&& other) :
+    m_pid(other.m_pid), m_stdin(other.m_stdin), m_stdout(other.m_stdout), m_stderr(other.m_stderr) {
+  other.m_pid   = -1;
+  other.m_stdin = other.m_stdout = other.m_stderr = -1;
+}
+
+Child& Child::operator=(Child&& other) {
+  if (this != &other) {
+    m_release();
+    m_pid         = other.m_pid;
+    m_stdin       = other.m_stdin;
+    m_stdout      = other.m_stdout;
+    m_stderr      = other.m_stderr;
+    other.m_pid   = -1;
+    other.m_stdin = other.m_stdout = other.m_stderr = -1;
+  }
+  return *this;
+}
+
+Child::~Child() {
+  m_release();
+}
+
+void Child::m_release() {
+  close_fd(m_stdin);
+  close_fd(m_stdout);
+  close_fd(m_stderr);
+
+  // Reap the child if it has already exited, one still running is left to become a zombie
+  if (m_pid > 0) {
+    waitpid(m_pid, nullptr, WNOHANG);
+    m_pid = -1;
+  }
+}
+
+void Child::close_stdin() {
+  close_fd(m_stdin);
+}
+
+Result<ExitStatus, ProcessError> Child::wait() {
+  close_stdin();
+
+  // A moved from (or already waited for) child has no pid, and waitpid(-1) would reap any child
+  if (m_pid <= 0) {
+    return ProcessError{ProcessError::Wait, ECHILD};
+  }
+
+  int status;
+  while (waitpid(m_pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      return ProcessError{ProcessError::Wait, errno};
+    }
+  }
+  m_pid = -1;
+  return ExitStatus{status};
+}
+
+Result<ProcessOutput, ProcessError> Child::wait_with_output() {
+  close_stdin();
+
+  ProcessOutput output;
+  char buffer[64 * 1024];
+
+  // Both streams are drained together, so a child blocked writing to one never deadlocks against a read of the other
+  while (m_stdout >= 0 || m_stderr >= 0) {
+    pollfd fds[2] = {{m_stdout, POLLIN, 0}, {m_stderr, POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return ProcessError{ProcessError::Read, errno};
+    }
+
+    for (int i = 0; i < 2; i++) {
+      if (fds[i].fd < 0 || !fds[i].revents) {
+        continue;
+      }
+      int&         fd     = i == 0 ? m_stdout : m_stderr;
+      std::string& target = i == 0 ? output.out : output.err;
+
+      auto count = read(fd, buffer, sizeof(buffer));
+      if (count > 0) {
+        target.append(buffer, std::size_t(count));
+      } else if (count == 0) {
+        close_fd(fd);
+      } else if (errno != EINTR && errno != EAGAIN) {
+        return ProcessError{ProcessError::Read, errno};
+      }
+    }
+  }
+
+  auto status = wait();
+  if (!status.is_good()) {
+    return status.peek_error();
+  }
+  output.status = status.peek_value();
+  return output;
+}
+
+//
+// Commands
+//
+
+Command::Command(std::string program) {
+  m_args.push_back(std::move(program));
+}
+
+Command& Command::arg(std::string_view argument) {
+  m_args.emplace_back(argument);
+  return *this;
+}
+
+Command& Command::args(std::initializer_list<std::string_view> arguments) {
+  for (auto argument : arguments) {
+    m_args.emplace_back(argument);
+  }
+  return *this;
+}
+
+Command& Command::environment(EnvSnapshot env) {
+  m_env = std::move(env);
+  return *this;
+}
+
+Command& Command::stdin_mode(Stdio stdio) {
+  m_stdin = stdio;
+  return *this;
+}
+
+Command& Command::stdout_mode(Stdio stdio) {
+  m_stdout = stdio;
+  return *this;
+}
+
+Command& Command::stderr_mode(Stdio stdio) {
+  m_stderr = stdio;
+  return *this;
+}
+
+Result<Child, ProcessError> Command::spawn() const {
+  std::vector<char*> argv;
+  argv.reserve(m_args.size() + 1);
+  for (auto const& argument : m_args) {
+    argv.push_back(const_cast<char*>(argument.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  char* const* envp = m_env ? m_env->envp() : environ;
+
+  Stdio modes[3]       = {m_stdin, m_stdout, m_stderr};
+  int   parent_ends[3] = {-1, -1, -1};
+  int   child_ends[3]  = {-1, -1, -1};
+
+  auto close_pipes = [&] {
+    for (int i = 0; i < 3; i++) {
+      close_fd(parent_ends[i]);
+      close_fd(child_ends[i]);
+    }
+  };
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+
+  // The child starts from a clean slate, rather than inheriting the calling thread's blocked signals
+  // and any ignored signals (i.e a parent ignoring SIGPIPE). Handled signals are reset by exec anyway
+  posix_spawnattr_t attributes;
+  posix_spawnattr_init(&attributes);
+  sigset_t signals;
+  sigemptyset(&signals);
+  posix_spawnattr_setsigmask(&attributes, &signals);
+  sigfillset(&signals);
+  posix_spawnattr_setsigdefault(&attributes, &signals);
+  posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+  for (int i = 0; i < 3; i++) {
+    if (modes[i] == Stdio::Null) {
+      posix_spawn_file_actions_addopen(&actions, i, "/dev/null", i == 0 ? O_RDONLY : O_WRONLY, 0);
+    } else if (modes[i] == Stdio::Pipe) {
+      // Close-on-exec, so the pipes never leak into other children (dup2 clears the flag on the child's copy)
+      int ends[2];
+      if (pipe2(ends, O_CLOEXEC) < 0) {
+        int error = errno;
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attributes);
+        close_pipes();
+        return ProcessError{ProcessError::Pipe, error};
+      }
+      child_ends[i]  = i == 0 ? ends[0] : ends[1];
+      parent_ends[i] = i == 0 ? ends[1] : ends[0];
+      posix_spawn_file_actions_adddup2(&actions, child_ends[i], i);
+    }
+  }
+
+  pid_t       pid;
+  char const* program = m_args[0].c_str();
+  int         error   = m_args[0].find('/') != std::string::npos
+                            ? posix_spawn(&pid, program, &actions, &attributes, argv.data(), envp)
+                            : posix_spawnp(&pid, program, &actions, &attributes, argv.data(), envp);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attributes);
+
+  for (int i = 0; i < 3; i++) {
+    close_fd(child_ends[i]);
+  }
+  if (error) {
+    close_pipes();
+    return ProcessError{ProcessError::Spawn, error};
+  }
+  return Child(pid, parent_ends[0], parent_ends[1], parent_ends[2]);
+}
+
+Result<ExitStatus, ProcessError> Command::status() const {
+  auto child = spawn();
+  if (!child.is_good()) {
+    return child.peek_error();
+  }
+  return child.value_or_panic().wait();
+}
+
+Result<ProcessOutput, ProcessError> Command::output() const {
+  Command capturing  = *this;
+  capturing.m_stdin  = Stdio::Null;
+  capturing.m_stdout = Stdio::Pipe;
+  capturing.m_stderr = Stdio::Pipe;
+
+  auto child = capturing.spawn();
+  if (!child.is_good()) {
+    return child.peek_error();
+  }
+  return child.value_or_panic().wait_with_output();
+}
+
+#endif
@@ -0,0 +1,529 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+//
+//
+// SIMD string kernels, with runtime CPU dispatch
+//
+// Each kernel processes the bulk of its input in vector-sized blocks, and
+// hands the remainder to the scalar implementations from string.h
+//
+//
+
+#include "../include/mutils/string.h"
+#include <cstdint>
+#include <cstring>
+
+using namespace mutils::string;
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define MUTILS_STRING_X86 1
+#  include <immintrin.h>
+#endif
+
+namespace {
+
+#ifdef MUTILS_STRING_X86
+
+//
+// Range-compare helpers
+//
+// (uint8)(c - lo) <= (hi - lo) is evaluated with signed comparisons
+// by biasing both sides by 0x80, as SSE2/AVX2 lack unsigned byte compares
+//
+
+inline __m128i in_range_sse2(__m128i x, char lo, char hi) {
+  __m128i shifted = _mm_add_epi8(x, _mm_set1_epi8(static_cast<char>(0x80 - lo)));
+  return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(0x80 + (hi - lo) + 1)));
+}
+
+inline __m128i strippable_sse2(__m128i x) {
+  return _mm_or_si128(in_range_sse2(x, 1, 32), _mm_cmpeq_epi8(x, _mm_set1_epi8(127)));
+}
+
+__attribute__((target("avx2"))) inline __m256i in_range_avx2(__m256i x, char lo, char hi) {
+  __m256i shifted = _mm256_add_epi8(x, _mm256_set1_epi8(static_cast<char>(0x80 - lo)));
+  return _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(0x80 + (hi - lo) + 1)), shifted);
+}
+
+__attribute__((target("avx2"))) inline __m256i strippable_avx2(__m256i x) {
+  return _mm256_or_si256(in_range_avx2(x, 1, 32), _mm256_cmpeq_epi8(x, _mm256_set1_epi8(127)));
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline __mmask64 in_range_avx512(__m512i x, char lo, char hi) {
+  return _mm512_cmple_epu8_mask(_mm512_sub_epi8(x, _mm512_set1_epi8(lo)), _mm512_set1_epi8(hi - lo));
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline __mmask64 strippable_avx512(__m512i x) {
+  return in_range_avx512(x, 1, 32) | _mm512_cmpeq_epi8_mask(x, _mm512_set1_epi8(127));
+}
+
+//
+// SSE2
+//
+
+template <char LO, char HI> void case_flip_sse2(char* data, std::size_t n) noexcept {
+  __m128i const flip = _mm_set1_epi8(0x20);
+  std::size_t   i    = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i x    = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+    __m128i mask = in_range_sse2(x, LO, HI);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(x, _mm_and_si128(mask, flip)));
+  }
+  if constexpr (LO == 'a') {
+    detail::to_upper_scalar(data + i, n - i);
+  } else {
+    detail::to_lower_scalar(data + i, n - i);
+  }
+}
+
+std::size_t count_strippable_start_sse2(char const* data, std::size_t n) noexcept {
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i  x    = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+    unsigned keep = ~static_cast<unsigned>(_mm_movemask_epi8(strippable_sse2(x))) & 0xFFFF;
+    if (keep) {
+      return i + __builtin_ctz(keep);
+    }
+  }
+  return i + detail::count_strippable_start_scalar(data + i, n - i);
+}
+
+std::size_t count_strippable_end_sse2(char const* data, std::size_t n) noexcept {
+  std::size_t count = 0;
+  for (; count + 16 <= n; count += 16) {
+    __m128i  x    = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + n - count - 16));
+    unsigned keep = ~static_cast<unsigned>(_mm_movemask_epi8(strippable_sse2(x))) & 0xFFFF;
+    if (keep) {
+      // The highest kept byte is the last non-strippable char
+      return count + (__builtin_clz(keep) - 16);
+    }
+  }
+  return count + detail::count_strippable_end_scalar(data, n - count);
+}
+
+void split_sse2(char const* data, std::size_t n, char sep, std::vector<std::string_view>& out) {
+  __m128i const needle   = _mm_set1_epi8(sep);
+  std::size_t   last_idx = 0;
+  std::size_t   i        = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i  x    = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+    unsigned hits = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, needle)));
+    while (hits) {
+      std::size_t idx = i + __builtin_ctz(hits);
+      out.emplace_back(data + last_idx, idx - last_idx);
+      last_idx = idx + 1;
+      hits &= hits - 1;
+    }
+  }
+  for (; i < n; i++) {
+    if (data[i] == sep) {
+      out.emplace_back(data + last_idx, i - last_idx);
+      last_idx = i + 1;
+    }
+  }
+  out.emplace_back(data + last_idx, n - last_idx);
+}
+
+//
+// AVX2
+//
+
+template <char LO, char HI> __attribute__((target("avx2"))) void case_flip_avx2(char* data, std::size_t n) noexcept {
+  __m256i const flip = _mm256_set1_epi8(0x20);
+  std::size_t   i    = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i x    = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+    __m256i mask = in_range_avx2(x, LO, HI);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(x, _mm256_and_si256(mask, flip)));
+  }
+  case_flip_sse2<LO, HI>(data + i, n - i);
+}
+
+__attribute__((target("avx2"))) std::size_t count_strippable_start_avx2(char const* data, std::size_t n) noexcept {
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i  x    = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+    uint32_t keep = ~static_cast<uint32_t>(_mm256_movemask_epi8(strippable_avx2(x)));
+    if (keep) {
+      return i + __builtin_ctz(keep);
+    }
+  }
+  return i + count_strippable_start_sse2(data + i, n - i);
+}
+
+__attribute__((target("avx2"))) std::size_t count_strippable_end_avx2(char const* data, std::size_t n) noexcept {
+  std::size_t count = 0;
+  for (; count + 32 <= n; count += 32) {
+    __m256i  x    = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + n - count - 32));
+    uint32_t keep = ~static_cast<uint32_t>(_mm256_movemask_epi8(strippable_avx2(x)));
+    if (keep) {
+      return count + __builtin_clz(keep);
+    }
+  }
+  return count + count_strippable_end_sse2(data, n - count);
+}
+
+__attribute__((target("avx2"))) void split_avx2(char const*                    data,
+                                                std::size_t                    n,
+                                                char                           sep,
+                                                std::vector<std::string_view>& out) {
+  __m256i const needle   = _mm256_set1_epi8(sep);
+  std::size_t   last_idx = 0;
+  std::size_t   i        = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i  x    = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+    uint32_t hits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, needle)));
+    while (hits) {
+      std::size_t idx = i + __builtin_ctz(hits);
+      out.emplace_back(data + last_idx, idx - last_idx);
+      last_idx = idx + 1;
+      hits &= hits - 1;
+    }
+  }
+  for (; i < n; i++) {
+    if (data[i] == sep) {
+      out.emplace_back(data + last_idx, i - last_idx);
+      last_idx = i + 1;
+    }
+  }
+  out.emplace_back(data + last_idx, n - last_idx);
+}
+
+//
+// AVX-512BW
+//
+// Uses masked loads/stores, so the tail never falls back to scalar code
+//
+
+template <char LO, char HI>
+__attribute__((target("avx512f,avx512bw"))) void case_flip_avx512(char* data, std::size_t n) noexcept {
+  __m512i const flip = _mm512_set1_epi8(0x20);
+  for (std::size_t i = 0; i < n; i += 64) {
+    __mmask64 active = n - i >= 64 ? ~__mmask64(0) : (__mmask64(1) << (n - i)) - 1;
+    __m512i   x      = _mm512_maskz_loadu_epi8(active, data + i);
+    __mmask64 mask   = in_range_avx512(x, LO, HI);
+    _mm512_mask_storeu_epi8(data + i, active, _mm512_mask_blend_epi8(mask, x, _mm512_xor_si512(x, flip)));
+  }
+}
+
+__attribute__((target("avx512f,avx512bw"))) std::size_t count_strippable_start_avx512(char const* data,
+                                                                                     std::size_t n) noexcept {
+  std::size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    __m512i  x    = _mm512_loadu_si512(data + i);
+    uint64_t keep = ~strippable_avx512(x);
+    if (keep) {
+      return i + __builtin_ctzll(keep);
+    }
+  }
+  return i + count_strippable_start_avx2(data + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) std::size_t count_strippable_end_avx512(char const* data,
+                                                                                   std::size_t n) noexcept {
+  std::size_t count = 0;
+  for (; count + 64 <= n; count += 64) {
+    __m512i  x    = _mm512_loadu_si512(data + n - count - 64);
+    uint64_t keep = ~strippable_avx512(x);
+    if (keep) {
+      return count + __builtin_clzll(keep);
+    }
+  }
+  return count + count_strippable_end_avx2(data, n - count);
+}
+
+__attribute__((target("avx512f,avx512bw"))) void split_avx512(char const*                    data,
+                                                              std::size_t                    n,
+                                                              char                           sep,
+                                                              std::vector<std::string_view>& out) {
+  __m512i const needle   = _mm512_set1_epi8(sep);
+  std::size_t   last_idx = 0;
+  for (std::size_t i = 0; i < n; i += 64) {
+    __mmask64 active = n - i >= 64 ? ~__mmask64(0) : (__mmask64(1) << (n - i)) - 1;
+    __m512i   x      = _mm512_maskz_loadu_epi8(active, data + i);
+    uint64_t  hits   = _mm512_mask_cmpeq_epi8_mask(active, x, needle);
+    while (hits) {
+      std::size_t idx = i + __builtin_ctzll(hits);
+      out.emplace_back(data + last_idx, idx - last_idx);
+      last_idx = idx + 1;
+      hits &= hits - 1;
+    }
+  }
+  out.emplace_back(data + last_idx, n - last_idx);
+}
+
+//
+// Substring search
+//
+// Candidate positions are those where both the first and the last byte of
+// the needle match, these are found a whole block at a time, and only the
+// candidates are verified with memcmp
+//
+// The multi-needle kernels OR together the candidate masks of every needle
+//
+
+inline bool matches_at(char const* data, std::string_view needle) noexcept {
+  return std::memcmp(data, needle.data(), needle.size()) == 0;
+}
+
+inline std::size_t find_tail(char const* data, std::size_t n, std::size_t i, char const* needle, std::size_t m) noexcept {
+  std::size_t pos = detail::find_scalar(data + i, n - i, needle, m);
+  return pos == std::string_view::npos ? pos : pos + i;
+}
+
+// Check the needles at a candidate position, lowest index first
+inline std::size_t needle_at(char const*             data,
+                             std::size_t             remaining,
+                             std::string_view const* needles,
+                             std::size_t             count) noexcept {
+  for (std::size_t k = 0; k < count; k++) {
+    if (needles[k].size() <= remaining && matches_at(data, needles[k])) {
+      return k;
+    }
+  }
+  return count;
+}
+
+inline FindAnyResult find_any_tail(char const*             data,
+                                   std::size_t             n,
+                                   std::size_t             i,
+                                   std::string_view const* needles,
+                                   std::size_t             count) noexcept {
+  FindAnyResult ret = detail::find_any_scalar(data + i, n - i, needles, count);
+  if (ret.pos != std::string_view::npos) {
+    ret.pos += i;
+  }
+  return ret;
+}
+
+inline std::size_t longest_needle(std::string_view const* needles, std::size_t count) noexcept {
+  std::size_t ret = 0;
+  for (std::size_t k = 0; k < count; k++) {
+    ret = needles[k].size() > ret ? needles[k].size() : ret;
+  }
+  return ret;
+}
+
+std::size_t find_sse2(char const* data, std::size_t n, char const* needle, std::size_t m) noexcept {
+  if (m == 1) {
+    auto const* hit = static_cast<char const*>(std::memchr(data, needle[0], n));
+    return hit ? std::size_t(hit - data) : std::string_view::npos;
+  }
+
+  __m128i const first = _mm_set1_epi8(needle[0]);
+  __m128i const last  = _mm_set1_epi8(needle[m - 1]);
+  std::size_t   i     = 0;
+  for (; i + m + 15 <= n; i += 16) {
+    __m128i  block_first = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+    __m128i  block_last  = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i + m - 1));
+    unsigned candidates  = static_cast<unsigned>(
+        _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last))));
+    while (candidates) {
+      std::size_t pos = i + __builtin_ctz(candidates);
+      if (std::memcmp(data + pos + 1, needle + 1, m - 2) == 0) {
+        return pos;
+      }
+      candidates &= candidates - 1;
+    }
+  }
+  return find_tail(data, n, i, needle, m);
+}
+
+FindAnyResult find_any_sse2(char const* data, std::size_t n, std::string_view const* needles, std::size_t count) noexcept {
+  __m128i     firsts[detail::MAX_SIMD_NEEDLES];
+  __m128i     lasts[detail::MAX_SIMD_NEEDLES];
+  std::size_t longest = longest_needle(needles, count);
+  for (std::size_t k = 0; k < count; k++) {
+    firsts[k] = _mm_set1_epi8(needles[k].front());
+    lasts[k]  = _mm_set1_epi8(needles[k].back());
+  }
+
+  std::size_t i = 0;
+  for (; i + longest + 15 <= n; i += 16) {
+    __m128i block      = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+    __m128i candidates = _mm_setzero_si128();
+    for (std::size_t k = 0; k < count; k++) {
+      __m128i block_last = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i + needles[k].size() - 1));
+      candidates         = _mm_or_si128(
+          candidates, _mm_and_si128(_mm_cmpeq_epi8(block, firsts[k]), _mm_cmpeq_epi8(block_last, lasts[k])));
+    }
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(candidates));
+    while (mask) {
+      std::size_t pos = i + __builtin_ctz(mask);
+      std::size_t k   = needle_at(data + pos, n - pos, needles, count);
+      if (k != count) {
+        return {pos, k};
+      }
+      mask &= mask - 1;
+    }
+  }
+  return find_any_tail(data, n, i, needles, count);
+}
+
+__attribute__((target("avx2"))) std::size_t find_avx2(char const* data,
+                                                      std::size_t n,
+                                                      char const* needle,
+                                                      std::size_t m) noexcept {
+  if (m == 1) {
+    return find_sse2(data, n, needle, m);
+  }
+
+  __m256i const first = _mm256_set1_epi8(needle[0]);
+  __m256i const last  = _mm256_set1_epi8(needle[m - 1]);
+  std::size_t   i     = 0;
+  for (; i + m + 31 <= n; i += 32) {
+    __m256i  block_first = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+    __m256i  block_last  = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i + m - 1));
+    uint32_t candidates  = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last))));
+    while (candidates) {
+      std::size_t pos = i + __builtin_ctz(candidates);
+      if (std::memcmp(data + pos + 1, needle + 1, m - 2) == 0) {
+        return pos;
+      }
+      candidates &= candidates - 1;
+    }
+  }
+  return find_tail(data, n, i, needle, m);
+}
+
+__attribute__((target("avx2"))) FindAnyResult find_any_avx2(char const*             data,
+                                                            std::size_t             n,
+                                                            std::string_view const* needles,
+                                                            std::size_t             count) noexcept {
+  __m256i     firsts[detail::MAX_SIMD_NEEDLES];
+  __m256i     lasts[detail::MAX_SIMD_NEEDLES];
+  std::size_t longest = longest_needle(needles, count);
+  for (std::size_t k = 0; k < count; k++) {
+    firsts[k] = _mm256_set1_epi8(needles[k].front());
+    lasts[k]  = _mm256_set1_epi8(needles[k].back());
+  }
+
+  std::size_t i = 0;
+  for (; i + longest + 31 <= n; i += 32) {
+    __m256i block      = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+    __m256i candidates = _mm256_setzero_si256();
+    for (std::size_t k = 0; k < count; k++) {
+      __m256i block_last = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i + needles[k].size() - 1));
+      candidates         = _mm256_or_si256(
+          candidates, _mm256_and_si256(_mm256_cmpeq_epi8(block, firsts[k]), _mm256_cmpeq_epi8(block_last, lasts[k])));
+    }
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(candidates));
+    while (mask) {
+      std::size_t pos = i + __builtin_ctz(mask);
+      std::size_t k   = needle_at(data + pos, n - pos, needles, count);
+      if (k != count) {
+        return {pos, k};
+      }
+      mask &= mask - 1;
+    }
+  }
+  return find_any_tail(data, n, i, needles, count);
+}
+
+__attribute__((target("avx512f,avx512bw"))) std::size_t find_avx512(char const* data,
+                                                                    std::size_t n,
+                                                                    char const* needle,
+                                                                    std::size_t m) noexcept {
+  if (m == 1) {
+    return find_sse2(data, n, needle, m);
+  }
+
+  __m512i const first = _mm512_set1_epi8(needle[0]);
+  __m512i const last  = _mm512_set1_epi8(needle[m - 1]);
+  std::size_t   i     = 0;
+  for (; i + m + 63 <= n; i += 64) {
+    __m512i  block_first = _mm512_loadu_si512(data + i);
+    __m512i  block_last  = _mm512_loadu_si512(data + i + m - 1);
+    uint64_t candidates =
+        _mm512_mask_cmpeq_epi8_mask(_mm512_cmpeq_epi8_mask(block_first, first), block_last, last);
+    while (candidates) {
+      std::size_t pos = i + __builtin_ctzll(candidates);
+      if (std::memcmp(data + pos + 1, needle + 1, m - 2) == 0) {
+        return pos;
+      }
+      candidates &= candidates - 1;
+    }
+  }
+  std::size_t pos = find_avx2(data + i, n - i, needle, m);
+  return pos == std::string_view::npos ? pos : pos + i;
+}
+
+#endif
+
+detail::StringKernels select_kernels() noexcept {
+#ifdef MUTILS_STRING_X86
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx512bw")) {
+    return {
+        case_flip_avx512<'a', 'z'>,
+        case_flip_avx512<'A', 'Z'>,
+        count_strippable_start_avx512,
+        count_strippable_end_avx512,
+        split_avx512,
+        find_avx512,
+        find_any_avx2,
+    };
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return {
+        case_flip_avx2<'a', 'z'>,
+        case_flip_avx2<'A', 'Z'>,
+        count_strippable_start_avx2,
+        count_strippable_end_avx2,
+        split_avx2,
+        find_avx2,
+        find_any_avx2,
+    };
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return {
+        case_flip_sse2<'a', 'z'>,
+        case_flip_sse2<'A', 'Z'>,
+        count_strippable_start_sse2,
+        count_strippable_end_sse2,
+        split_sse2,
+        find_sse2,
+        find_any_sse2,
+    };
+  }
+#endif
+
+  return {
+      detail::to_upper_scalar,
+      detail::to_lower_scalar,
+      detail::count_strippable_start_scalar,
+      detail::count_strippable_end_scalar,
+      detail::split_scalar,
+      detail::find_scalar,
+      detail::find_any_scalar,
+  };
+}
+
+} // namespace
+
+detail::StringKernels const& detail::kernels() noexcept {
+  static StringKernels const selected = select_kernels();
+  return selected;
+}
@@ -0,0 +1,84 @@
+/// Copyright (c) 2023 Samir Bioud
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+/// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+/// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+/// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+/// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+/// OR OTHER DEALINGS IN THE SOFTWARE.
+///
+
+
+
+//
+// Reusing a monotonic arena across frames with a pmr::PolyVec
+//
+// Each frame fills the vector, drops it with `release_all()` and releases the arena,
+// so nothing (neither the items nor the slot arrays) may outlive the frame.
+// Built with AddressSanitizer, which reports any use of the released arena memory
+//
+
+#include "mutils/polyvec.h"
+#include <cstdio>
+#include <memory_resource>
+#include <string>
+
+struct Node {
+  virtual ~Node()            = default;
+  virtual long value() const = 0;
+};
+
+struct Leaf : Node {
+  long v;
+  explicit Leaf(long v) : v(v) {}
+  long value() const override { return v; }
+};
+
+struct Named : Node {
+  std::pmr::string name;
+  Named(long v, std::pmr::memory_resource* res) : name(std::size_t(v % 64) + 32, 'x', res) {}
+  long value() const override { return long(name.size()); }
+};
+
+int main() {
+  std::pmr::monotonic_buffer_resource arena;
+  mutils::pmr::PolyVec<Node>          nodes(&arena);
+
+  for (int frame = 0; frame < 3; frame++) {
+    long expected = 0;
+    for (long i = 0; i < 1000; i++) {
+      if (i % 3 == 0) {
+        nodes.emplace<Named>(i, &arena);
+        expected += long(i % 64) + 32;
+      } else {
+        nodes.emplace<Leaf>(i);
+        expected += i;
+      }
+    }
+
+    long total = 0;
+    for (auto& node : nodes) {
+      total += node.value();
+    }
+    if (total != expected || nodes.size() != 1000) {
+      std::fprintf(stderr, "frame %d: expected %ld (1000 items), got %ld (%zu items)\n", frame, expected, total,
+                   nodes.size());
+      return 1;
+    }
+
+    nodes.release_all();
+    arena.release();
+  }
+  return 0;
+}